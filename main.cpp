@@ -6,20 +6,38 @@
 #include <fstream>
 #include <sstream>
 #include <string.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <set>
+#include <climits>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <memory>
+#include <random>
+#include <cmath>
+#include <deque>
 
 //This is a CPP that will be compiled under c++ standard 11
-//compilable with g++ -o main main.cpp -std=c++11
+//compilable with g++ -o main main.cpp -std=c++11 -pthread
 
 using namespace std;
 
 struct MainInfo {
     uint8_t *mem = new uint8_t[67108864];
     int currentPID = 1024;
-    vector<int> frame;
+    mutex lock; //held by the command loop while it runs a command and by the reclaimer
 } mainInfo;
 
 struct CommandInput {
     int pageSize;
+    int addressBits = 21; //virtual address width given to new processes, 21 bits is 2MB
 }commandInput;
 
 struct MMUObject {
@@ -29,11 +47,19 @@ struct MMUObject {
     int pid;
     int typeCode;//0=text/global/stack/freespace 1=char 2=short 3=int 4=double 5=long 6=float
     string name;
-    int address;
-    int size;
+    long long address;
+    long long size; //a variable holds at most INT_MAX bytes, placement and copies use int sizes
     string key;
     int physicalAddr;
     map<int, int> pageInfo; //map<pageNumber, sizeInThatPage>
+    int mapping = -1; //pageCache.mappings id if the variable maps a host file, -1 otherwise
+    bool pinned = false; //advise populate pinned the pages of the variable in RAM
+};
+
+struct PageRun {
+    int pageNumber;
+    int offset; //where the piece starts inside the page
+    int length;
 };
 
 struct PageUnit {
@@ -42,9 +68,66 @@ struct PageUnit {
     int freeSpace;
     int pageNumber;
     int frameNumber;
-    int inMem; //1 if the corresponding frame is in memory rather than RAM
+    int inMem; //1 if the corresponding frame is in the swap file rather than RAM
+    int referenced; //1 if accessed since the eviction clock last passed the page
+    int dirty; //1 if written since it was last brought into RAM
+    long long lastAccess; //accessInfo.clock at the last access, 0 if never accessed
+    int mapping; //pageCache.mappings id of the file mapping the page belongs to, -1 for anonymous memory
+    int pinned; //pinned variables on the page, the page is never evicted while above 0
+};
+
+const int PAGE_TABLE_BITS = 9; //512 entries per table, as on x86-64
+
+struct PageTableNode {
+    vector<unique_ptr<PageTableNode>> children; //tables of the next level, empty in a leaf
+    vector<PageUnit> entries; //page table entries, only in a leaf
+};
+
+//radix page table of a process: levels tables deep, the root indexed by topBits of
+//the page number and every other level by PAGE_TABLE_BITS. Tables are only allocated
+//once a page under them is used, so a large address space costs nothing until touched.
+struct PageTable {
+    int pid = 0;
+    int pages = 0; //page numbers run from 0 to pages - 1
+    int levels = 2;
+    int topBits = PAGE_TABLE_BITS;
+    unique_ptr<PageTableNode> root;
+    long long tables = 0; //tables allocated at every level
+    long long bytes = 0; //memory taken by those tables
+    long long walks = 0; //translations made through walk
+    long long walkSteps = 0; //tables read by those translations
+
+    void init(int ownerPid, int pageCount);
+    void release(); //hands every table to pageTableSpares
+    PageUnit &operator[](int pageNumber); //allocates the tables on the way if missing
+    PageUnit &walk(int pageNumber); //operator[] counted as a translation
+    vector<PageUnit*> entries(); //every entry of the allocated leaves, in page order
+};
+
+//tables given up by page tables, reused before new ones are allocated
+struct PageTableSpares {
+    vector<unique_ptr<PageTableNode>> leaves;
+    vector<unique_ptr<PageTableNode>> tables; //every level above the leaves
+} pageTableSpares;
+
+//RAM is split into nodes of neighbouring frames, every node hands out its own frames
+struct NumaNode {
+    int firstFrame;
+    int frames;
+    int nextFresh; //frames from here to the end of the node were never handed out
+    set<int> freed; //frames below nextFresh that were handed back
 };
 
+const int NUMA_FIRST_TOUCH = 0; //pages go to the node of the process that touches them first
+const int NUMA_INTERLEAVE = 1; //pages go round robin over all nodes by page number
+const int NUMA_MAX_NODES = 8;
+
+struct NumaInfo {
+    vector<NumaNode> nodes;
+    int policy = NUMA_FIRST_TOUCH; //placement policy of processes created without one
+    int nextNode = 0; //node given to the next process created without one
+} numaInfo;
+
 struct FrameTable {
     map<int, PageUnit> table; //key: frameNumber, value: page struct
 }frameTable;
@@ -60,13 +143,29 @@ struct Process {
     int globals; //some number 0-1024 bytes
     const int stack{65536}; //stack constant in bytes
     //VarMap nums;
-    int pages = 67108864 / commandInput.pageSize;
-    int amountPageUsed = 0;
+    int addressBits = commandInput.addressBits; //width of the virtual address space
+    int pages = (1LL << addressBits) / commandInput.pageSize;
     PageUnit currentPage;
-    map<int, PageUnit> pageTable;
-    int totalPageRemainSpace;
+    int tailSpace = 0; //unused bytes at the end of currentPage, where pageHandler places next,
+                       //currentPage.freeSpace also counts the holes frees left before them
+    PageTable pageTable;
+    long long totalPageRemainSpace; //freeSpace of every page added up
+    int numaNode = 0; //node the process runs on
+    int numaPolicy = NUMA_FIRST_TOUCH;
+    long long localAccesses = 0; //accesses to frames on numaNode
+    long long remoteAccesses = 0; //accesses to frames on other nodes
+    long long accesses = 0; //translated accesses made by set and print
+    long long faults = 0; //accesses that had to bring a page back from swap
+    int residentPages = 0; //pages holding a RAM frame
+    int swappedPages = 0; //pages in the compressed pool or memfile.txt
+    int rssQuota = 0; //most pages the process may keep in RAM, 0 means unlimited
+    int swapQuota = 0; //most pages the process may have swapped out, 0 means unlimited
 };//Process struct
 
+struct ProcessPool {
+    vector<Process*> spare; //terminated processes kept for the next create, without their page tables
+} processPool;
+
 struct ProcessTable{
     map<int, Process*> table; //key: pid, value: process struct
 }processTable;
@@ -81,32 +180,342 @@ struct VariableObject {
     float floatValue;
 };
 
+//Swap I/O runs on its own thread. Evicted pages are queued in pending and the
+//I/O thread writes them out in batches, merging neighbouring slots into one
+//pwrite. A slot stays readable from pending/writing until it reaches the file.
+struct SwapInfo {
+    int fd = -1; //memfile.txt, kept open for the whole run
+    thread worker;
+    mutex lock;
+    condition_variable wake; //signalled when there is work for the I/O thread
+    condition_variable drained; //signalled when the I/O thread finished a batch
+    bool stop = false;
+    map<int, vector<uint8_t>> pending; //key: swap slot, value: page waiting to be written
+    map<int, vector<uint8_t>> writing; //batch the I/O thread is writing right now
+    map<int, vector<uint8_t>> prefetched; //key: swap slot, value: page read ahead of a fault
+    vector<int> prefetchQueue; //slots the I/O thread should read ahead
+    int fileSlots = 0; //slots memfile.txt has to hold
+    bool shrink = false; //set when memfile.txt should be truncated to fileSlots
+    int clockHand = 0; //next RAM frame to consider for eviction
+    long long pagesOut = 0;
+    long long writeCalls = 0;
+    long long pagesIn = 0;
+    long long prefetchHits = 0;
+    long long prefetchReads = 0;
+    long long stalls = 0;
+} swapInfo;
+
+//Swap space is handed out slot by slot, independent of frame numbers. A swapped
+//out page has frameNumber -1 and inMem 1, and its slot is found in swapMap.
+struct SwapSpace {
+    map<pair<int, int>, int> swapMap; //key: (pid, pageNumber), value: slot in memfile.txt
+    set<int> freeSlots; //released slots below slotEnd
+    int slotEnd = 0; //slots ever handed out and not trimmed, memfile.txt is this long
+} swapSpace;
+
+struct ZswapEntry {
+    vector<uint8_t> data; //page compressed with zswapCompress
+    long long sequence; //key of the entry in ZswapPool.lru
+};
+
+//Compressed pages kept in RAM between eviction and memfile.txt. When the pool is
+//over budget its oldest pages are written back to swap slots.
+struct ZswapPool {
+    long long budget = 16777216; //bytes of compressed data the pool may hold, 0 disables it
+    long long used = 0; //bytes of compressed data held right now
+    map<pair<int, int>, ZswapEntry> entries; //key: (pid, pageNumber), value: compressed page
+    map<long long, pair<int, int>> lru; //key: store order, value: (pid, pageNumber)
+    long long sequence = 0;
+    long long stored = 0;
+    long long loads = 0;
+    long long rejected = 0; //pages that did not compress well enough
+    long long writtenBack = 0;
+} zswapPool;
+
+//Virtual time for working set estimation, one tick per translated page access
+struct AccessInfo {
+    long long clock = 0;
+    long long window = 4096; //a page accessed in the last window ticks is in the working set
+} accessInfo;
+
+//Background reclaim (kswapd style): when free RAM frames drop below lowWatermark
+//the reclaimer thread swaps out cold pages until highWatermark frames are free,
+//so allocations rarely have to evict inline. A command holds mainInfo.lock from start
+//to end, so the thread only runs between commands. generate is one long command and
+//runs the same pass itself between its operations.
+struct ReclaimInfo {
+    thread worker;
+    condition_variable_any wake; //waited on with mainInfo.lock
+    atomic<bool> stop{false};
+    int lowWatermark = 0; //free frames, set from the page size at startup
+    int highWatermark = 0;
+    long long wakeups = 0;
+    long long workloadPasses = 0; //passes generate ran between its operations
+    long long pagesReclaimed = 0; //pages swapped out by reclaimer passes
+    long long directReclaims = 0; //pages an allocation had to swap out itself
+} reclaimInfo;
+
+struct OomInfo {
+    long long kills = 0; //processes terminated by the OOM killer
+    long long quotaDenials = 0; //allocations refused because they would break a quota
+    long long quotaReclaims = 0; //pages a process at its RSS quota swapped out of itself
+} oomInfo;
+
+//memory advice given with the advise command
+struct AdviseInfo {
+    set<pair<int, int>> coldPages; //(pid, pageNumber) evicted before anything the clock picks
+} adviseInfo;
+
+const int PIN_LIMIT_PERCENT = 50; //share of the RAM frames populate may pin
+
+struct CompactInfo {
+    int threshold = 0; //percent of a process's pages that may be wasted before free or realloc compacts it, 0 is off
+} compactInfo;
+
+const int WORKLOAD_EXPONENTIAL = 0;
+const int WORKLOAD_UNIFORM = 1;
+const int WORKLOAD_FIXED = 2;
+const int WORKLOAD_ZIPF = 3;
+const int WORKLOAD_LOGNORMAL = 4;
+const int WORKLOAD_FREE_FIFO = 0; //oldest variable of the process first
+const int WORKLOAD_FREE_LIFO = 1; //newest variable first
+const int WORKLOAD_FREE_RANDOM = 2;
+
+//settings of the generate command, distributions are one of the WORKLOAD_ codes
+struct WorkloadConfig {
+    unsigned long long seed = 1;
+    long long operations = 0;
+    int processes = 8; //most workload processes alive at once
+    int addressBits = 21;
+    int arrivalDist = WORKLOAD_EXPONENTIAL; //operations between process arrivals
+    double arrivalMean = 500;
+    int lifetimeDist = WORKLOAD_EXPONENTIAL; //operations a process lives for
+    double lifetimeMean = 50000;
+    int sizeDist = WORKLOAD_UNIFORM; //elements per allocation, uniform, zipf or lognormal
+    int sizeMin = 1;
+    int sizeMax = 4096;
+    double zipfExponent = 1.0;
+    double sizeMu = 4.0; //of the log of the size, for lognormal
+    double sizeSigma = 1.0;
+    vector<int> typeWeights = {1, 1, 4, 2, 1, 1}; //char short int double long float
+    vector<int> opWeights = {30, 20, 35, 15}; //allocate free set read
+    int freeOrder = WORKLOAD_FREE_RANDOM;
+    bool verify = false; //keep a copy of every value set and compare reads with it
+    bool keep = false; //leave the processes running when the workload ends
+};
+
+struct WorkloadVariable {
+    string name;
+    int typeCode;
+    int count;
+    vector<uint8_t> shadow; //bytes last set, only with verify
+    vector<bool> known; //bytes of shadow that were set
+};
+
+struct WorkloadProcess {
+    int pid;
+    long long death; //operation the process is terminated at
+    deque<WorkloadVariable> variables; //in allocation order, unless frees are random
+};
+
+//swallows the output of the commands a workload runs
+struct DiscardBuffer : streambuf {
+    int overflow(int c) {
+        return c;
+    }
+};
+
+//points cout at another buffer for as long as it lives
+struct CoutRedirect {
+    streambuf *saved;
+    CoutRedirect(streambuf *target) : saved(cout.rdbuf(target)) {}
+    ~CoutRedirect() {
+        cout.rdbuf(saved);
+    }
+};
+
+struct MappedFile {
+    string path;
+    int fd = -1; //-1 if the file could not be opened again after a load, its pages read as zeros
+    dev_t device = 0;
+    ino_t inode = 0;
+    int mappings = 0; //regions mapping the file
+    int cachedPages = 0; //pages of the file in the page cache
+};
+
+struct FileMapping {
+    int fileId;
+    int pid;
+    int firstPage; //page of the process the region starts in
+    long long offset; //file offset of the first page, a multiple of the page size
+    long long length;
+};
+
+struct CacheEntry {
+    int frame;
+    int referenced = 1; //1 if accessed since the cache clock last passed the page
+    set<pair<int, int>> mappers; //(pid, pageNumber) of the process pages pointing at frame
+};
+
+//Pages of mapped host files. A cached page has one frame, outside the frameTable, that
+//every mapping of the file shares. Cached pages are always clean, a write gives the
+//writing process its own anonymous copy, so a cached page is dropped without any I/O.
+struct PageCache {
+    map<int, MappedFile> files; //key: file id
+    map<pair<dev_t, ino_t>, int> fileIds; //key: device and inode, value: file id
+    map<int, FileMapping> mappings; //key: mapping id
+    map<pair<int, long long>, CacheEntry> entries; //key: (file id, page of the file)
+    pair<int, long long> clockHand = make_pair(INT_MIN, LLONG_MIN); //next entry to consider for dropping
+    int nextFileId = 0;
+    int nextMapping = 0;
+    long long hits = 0; //faults on a mapped page that found it cached
+    long long misses = 0; //faults that read the page from its file
+    long long drops = 0; //clean pages dropped to free their frame
+    long long copies = 0; //private copies made by writes to mapped pages
+} pageCache;
+
+struct SnapshotReader {
+    const uint8_t *pos; //next unread byte of the mapped snapshot
+    const uint8_t *end;
+    bool ok = true; //false once a read ran past the end of the snapshot
+};
+
 const string COMMAND_NAME_EXIT = "exit";
 const string COMMAND_NAME_CREATE = "create";
 const string COMMAND_LINE_BREAK = "";
 
-void switchMem(PageUnit* page, int fnumber);
+const char SNAPSHOT_MAGIC[8] = {'M', 'E', 'M', 'S', 'N', 'A', 'P', '\0'};
+const uint32_t SNAPSHOT_VERSION = 10;
+const long long SWAP_SIZE = 511705088; //488MB of swap space in memfile.txt
+const int SWAP_QUEUE_LIMIT = 256; //pages queued for write-back before eviction has to wait
+const int SWAP_PREFETCH_PAGES = 4; //neighbouring pages read ahead on a swap-in fault
+const int SWAP_PREFETCH_LIMIT = 256; //pages kept in the read-ahead cache
+const int ZSWAP_ACCEPT_PERCENT = 75; //pages compressing worse than this go straight to disk
+const int RECLAIM_BATCH = 32; //pages the reclaimer swaps out before letting commands run
+const size_t PROCESS_POOL_LIMIT = 64; //spare processes kept by processPool
+const size_t PAGE_TABLE_SPARE_LIMIT = 1024; //spare tables of each kind kept by pageTableSpares
+
+bool switchMem(int pid, int pageNumber, int ownerPid);
 void takeCommand(int argc, char *argv[]);
 bool isNumber(const string& s);
-void createProcess();
+void createProcess(int addressBits, int numaNode, int numaPolicy);
+int maxAddressBits();
+void printPageTable(int pid);
 string findFreeSpaceMMU(int size, int pid);
+map<string, MMUObject>::iterator mmuFirst(int pid);
+map<string, MMUObject>::iterator mmuPast(int pid);
 void printMMU();
 void allocateVariable(int pid, string name, string type, int amount);
 bool findExistingPID(int pid);
 void terminatePID(int pid);
 void createPage(Process *process);
-void pageHandler(Process *process, MMUObject mmu);
-void freeFromPage(Process *process, MMUObject mmu);
+bool pageHandler(Process *process, MMUObject mmu);
+bool nextEmptyPage(Process *process);
+int emptyPagesAfter(Process *process, int pageNumber, int wanted);
+void freeFromPage(Process *process, const MMUObject& mmu);
+Process *acquireProcess();
+void releaseProcess(Process *process);
 void printPage();
 bool compareEntry( std::pair<string, MMUObject>& a, std::pair<string, MMUObject>& b);
 bool findExistingVariable(int pid, string name);
 void freeVariable(int pid, string name);
+void releaseVirtualRange(int pid, long long address, long long size);
+void reallocVariable(int pid, string name, int amount);
+void resizeVariable(int pid, string name, int amount);
+int typeCodeSize(int typeCode);
+vector<PageRun> variableRuns(const MMUObject& mmu);
+bool canGrowInPlace(Process *process, const MMUObject& mmu, int delta);
+void moveVariableData(Process *process, const MMUObject& from, const MMUObject& to);
+void compactProcess(int pid);
+void compactIfFragmented(int pid);
 void printProcesses();
 int findExistingVariableType(int pid, string name);
 void setValues(int pid, string name, int offset, vector<VariableObject> values);
-int lowestFrameNum();
+int lowestFrameNum(int node);
+int freeFrameCount();
+int nodeFreeFrames(int node);
+void numaConfigure(int nodeCount);
+int frameNode(int frame);
+void releaseFrame(int frame);
+int numaPolicyCode(string name);
+void printNuma();
+int allocateFrame(int pid, int pageNumber, bool cached);
+int takeFreeFrame(Process *process, int pageNumber, bool cached);
 void printVariable(int pid, string name);
 string trimWhiteSpace(string str);
+void saveSnapshot(string fileName);
+template<typename T> void snapshotWriteValue(FILE *file, T value);
+template<typename T> T snapshotReadValue(SnapshotReader &reader);
+void loadSnapshot(string fileName);
+void snapshotWriteString(FILE *file, const string& str);
+void snapshotWritePage(FILE *file, const PageUnit& page);
+string snapshotReadString(SnapshotReader &reader);
+PageUnit snapshotReadPage(SnapshotReader &reader);
+void swapStart();
+void swapShutdown();
+void swapWorker();
+void swapWriteBatch(map<int, vector<uint8_t>>& batch);
+void swapWriteSlot(int slot, const uint8_t *data);
+void swapReadSlot(int slot, uint8_t *data);
+void swapDiscardSlot(int slot);
+void swapDiscardAll();
+void swapSetFileSlots(int slots, bool shrink);
+int allocateSwapSlot(int pid, int pageNumber);
+void releaseSwapSlot(int pid, int pageNumber);
+void swapIn(Process *process, PageUnit& page);
+bool swapOutPage(int pid, int pageNumber, const uint8_t *data);
+void swapReadPage(int pid, int pageNumber, uint8_t *data);
+void releaseSwappedPage(int pid, int pageNumber);
+bool zswapStore(int pid, int pageNumber, const uint8_t *data);
+bool zswapLoad(int pid, int pageNumber, uint8_t *data);
+bool zswapWriteBack();
+void zswapCompress(const uint8_t *src, int length, vector<uint8_t>& dst);
+bool zswapDecompress(const vector<uint8_t>& src, uint8_t *dst, int length);
+void setConfig(string name, string value);
+void printConfig();
+void swapPrefetchNeighbours(Process *process, int pageNumber);
+int chooseVictimFrame(int pid, int pageNumber, int ownerPid);
+void syncCurrentPage(Process *process, const PageUnit& page);
+uint8_t *pageFrameAddress(Process *process, int pageNumber);
+void touchPage(Process *process, int pageNumber, bool write);
+void printWorkingSet(int pid);
+void reclaimStart();
+void reclaimSetWatermarks();
+void reclaimPass(unique_lock<mutex> *lk);
+void reclaimShutdown();
+void reclaimAbandon();
+void reclaimWorker();
+void printReclaim();
+int pagesNeeded(Process *process, int size);
+bool reserveMemory(int pid, int pages);
+int oomBadness(Process *process);
+bool oomKill(int excludePid, int requesterPid);
+void setQuota(int pid, string kind, int pages);
+void printQuota();
+void copyToVariable(const MMUObject& mmu, int offset, const uint8_t *src, int length);
+void copyFromVariable(const MMUObject& mmu, int offset, uint8_t *dst, int length);
+void printSwap();
+void mapFile(int pid, string name, string path, long long offset, long long length);
+void unmapRegion(Process *process, const MMUObject& mmu);
+bool hasFileMappings(int pid);
+pair<int, long long> pageCacheKey(const PageUnit& page);
+void filePageIn(Process *process, PageUnit& page);
+void pageCacheDetach(Process *process, PageUnit& page);
+uint8_t *privatePageAddress(Process *process, int pageNumber);
+bool pageCacheDrop();
+void pageCacheForget(int fileId);
+void pageCacheReset();
+void printPageCache();
+bool setWorkloadOption(WorkloadConfig &config, string name, string value);
+int workloadDistributionCode(string name);
+long long workloadInterval(mt19937_64 &rng, int dist, double mean);
+int workloadSize(const WorkloadConfig &config, mt19937_64 &rng, const vector<double> &zipfCdf);
+void runWorkload(const WorkloadConfig &config);
+void adviseVariable(int pid, string name, string advice);
+void pinPages(Process *process, const MMUObject& mmu, int delta);
+bool populateVariable(Process *process, MMUObject& mmu);
+int pinnedPageCount();
+void forgetColdPages(int pid);
 
 int main(int argc, char *argv[]) {
     string input;
@@ -114,42 +523,54 @@ int main(int argc, char *argv[]) {
     takeCommand(argc,argv);
     cout << "\nWelcome to the Memory Allocation Simulator! Using a page size of "<< commandInput.pageSize <<" bytes.\n"
             "Commands: \n"
-            "* create (initializes a new process)\n"
+            "* create [<address_bits> [<numa_node> [firsttouch|interleave]]] (initializes a new process, with a virtual address\n"
+            "  space of 2^address_bits bytes, running on numa_node and placing its pages with the given policy)\n"
             "  * allocate <PID> <var_name> <data_type> <number_of_elements> (allocated memory on the heap)\n"
+            "  * realloc <PID> <var_name> <number_of_elements> (resizes a variable, keeping its values)\n"
             "  * set <PID> <var_name> <offset> <value_0> <value_1> <value_2> ... <value_N> (set the value for a variable)\n"
             "  * free <PID> <var_name> (deallocate memory on the heap that is associated with <var_name>)\n"
             "  * terminate <PID> (kill the specified process)\n"
+            "  * compact <PID> (packs the variables of a process into as few pages as possible)\n"
+            "  * quota <PID> rss|swap <pages> (caps the pages a process keeps in RAM or in swap, 0 removes the cap)\n"
+            "  * generate <seed> <operations> [<name>=<value> ...] (runs a seeded random workload, options:\n"
+            "    processes, address_bits, arrival, arrival_dist, lifetime, lifetime_dist (exponential|uniform|fixed),\n"
+            "    size_dist (uniform|zipf|lognormal), size_min, size_max, zipf_s, size_mu, size_sigma,\n"
+            "    types (char,short,int,double,long,float weights), ops (allocate,free,set,read weights),\n"
+            "    free_order (fifo|lifo|random), verify (0|1), keep (0|1))\n"
+            "  * advise <PID> <var_name> populate|willneed|dontneed|cold|normal (populate faults the pages in and pins them,\n"
+            "    willneed reads swapped pages ahead, dontneed drops the pages so they read as zeros, cold makes them the\n"
+            "    next eviction victims, normal takes back populate and cold)\n"
+            "  * map <PID> <var_name> <hostfile> [offset] [length] (maps a host file as a char variable, read in page by page\n"
+            "    on first access and shared with other mappings of the file, writes give the process a private copy)\n"
             "  * print <object> (prints data)\n"
             "    * If <object> is \"mmu\", print the MMU memory table\n"
             "    * if <object> is \"page\", print the page table\n"
             "    * if <object> is \"processes\", print a list of PIDs for processes that are still running\n"
-            "    * if <object> is a \"<PID>:<var_name>\", print the value of the variable for that process" << endl;
-
-    //on startup create memory backing file
-    if(ifstream("memfile.txt")) {
-        FILE *file = fopen("memfile.txt", "rb");
-        fseek(file, 0, SEEK_END);
-        int leng = ftell(file);
-        fclose(file);//find length of file in bytes
-        if (leng == (1024*1024*488)) {
-            //the file is correct
-        } else {
-            ofstream outputFile("memfile.txt");
-            for(int i = 0; i<1024*488*1024; i++) {
-                outputFile<<"0";
-            }
-            outputFile.close();
-        }
-    } else {
-        ofstream outputFile("memfile.txt");
-        cout<< "CREATING NEW 488MB FILE, INITIALIZED TO 0s"<<endl;
-        for(int i = 0; i<1024*488*1024; i++) {
-            outputFile<<"0";
-        }
-        outputFile.close();
-    }//if doesn't already exist, create 488MB file : memfile.txt
+            "    * if <object> is \"swap\", print swap I/O and compressed pool counters\n"
+            "    * if <object> is \"workingset <PID>\", print the page access report of that process\n"
+            "    * if <object> is \"pagetable <PID>\", print the page table shape and page walk counters of that process\n"
+            "    * if <object> is \"numa\", print the frames of every NUMA node and the local and remote accesses of every process\n"
+            "    * if <object> is \"reclaim\", print free frame watermarks and reclaim counters\n"
+            "    * if <object> is \"quota\", print memory use, quotas and OOM badness of every process\n"
+            "    * if <object> is \"pagecache\", print the mapped files and page cache counters\n"
+            "    * if <object> is a \"<PID>:<var_name>\", print the value of the variable for that process\n"
+            "  * save <file> (writes a binary snapshot of the whole simulator state)\n"
+            "  * load <file> (restores the simulator state from a snapshot written by save)\n"
+            "  * config [<name> <value>] (lists or changes simulator settings)\n"
+            "    * zswap_budget <bytes> (size of the compressed swap pool, 0 disables it)\n"
+            "    * ws_window <accesses> (how far back the working set looks)\n"
+            "    * reclaim_low <frames> / reclaim_high <frames> (free frame watermarks of the background reclaimer)\n"
+            "    * address_bits <bits> (virtual address width of processes created without one)\n"
+            "    * numa_nodes <nodes> (splits RAM into that many NUMA nodes, only while no frame is in use)\n"
+            "    * numa_policy firsttouch|interleave (page placement of processes created without one)\n"
+            "    * compact_threshold <percent> (compact a process after free or realloc once this share of its pages is wasted, 0 disables it)" << endl;
 
-    mainInfo.frame.push_back(0);
+    //memfile.txt is the swap file, it starts empty and grows with the swapped out data
+    numaConfigure(1);
+    swapStart();
+    atexit(swapShutdown);
+    reclaimStart();
+    atexit(reclaimAbandon);
 
     while(true){
         restart:
@@ -157,6 +578,8 @@ int main(int argc, char *argv[]) {
 
         string input;
         getline(cin,input);
+        //the reclaimer only runs while no command is being executed
+        unique_lock<mutex> stateGuard(mainInfo.lock);
         input = trimWhiteSpace(input);
         vector<string> inpv;
         int start = 0;
@@ -175,9 +598,37 @@ int main(int argc, char *argv[]) {
 
         if(inpv[0] == COMMAND_NAME_EXIT){
             cout << "Goodbye" << endl;
+            stateGuard.unlock();
+            reclaimShutdown();
             break;
         }else if (inpv[0] == COMMAND_NAME_CREATE){
-            createProcess();
+            int addressBits = commandInput.addressBits;
+            int numaNode = numaInfo.nextNode;
+            int numaPolicy = numaInfo.policy;
+            if(inpv.size() > 4) {
+                cout << "create takes at most 3 arguments" << endl;
+            } else if(inpv.size() > 1 && (!isNumber(inpv[1]) || inpv[1].size() > 2 || stoi(inpv[1]) < 17
+                      || stoi(inpv[1]) > maxAddressBits())) {
+                cout << "The address width must be a number of bits from 17 to " << maxAddressBits() << endl;
+            } else if(inpv.size() > 2 && (!isNumber(inpv[2]) || inpv[2].size() > 1 || stoi(inpv[2]) >= (int)numaInfo.nodes.size())) {
+                cout << "The NUMA node must be from 0 to " << numaInfo.nodes.size() - 1 << endl;
+            } else if(inpv.size() > 3 && numaPolicyCode(inpv[3]) == -1) {
+                cout << "The NUMA policy must be firsttouch or interleave" << endl;
+            } else {
+                if(inpv.size() > 1) {
+                    addressBits = stoi(inpv[1]);
+                }
+                if(inpv.size() > 2) {
+                    numaNode = stoi(inpv[2]);
+                } else {
+                    //processes without a node are spread over the nodes
+                    numaInfo.nextNode = (numaInfo.nextNode + 1) % numaInfo.nodes.size();
+                }
+                if(inpv.size() > 3) {
+                    numaPolicy = numaPolicyCode(inpv[3]);
+                }
+                createProcess(addressBits, numaNode, numaPolicy);
+            }
         }else if (inpv[0] == COMMAND_LINE_BREAK){
             //do nothing
         } else if(inpv[0] == "print"){
@@ -187,6 +638,28 @@ int main(int argc, char *argv[]) {
                 printMMU();
             } else if (inpv[1] == "page" && inpv.size() == 2) {
                 printPage();
+            } else if(inpv[1] == "swap" && inpv.size() == 2) {
+                printSwap();
+            } else if(inpv[1] == "workingset" && inpv.size() == 3) {
+                if(isNumber(inpv[2]) && inpv[2].size() <= 9 && processTable.table.count(stoi(inpv[2])) == 1) {
+                    printWorkingSet(stoi(inpv[2]));
+                } else {
+                    cout << "The provided PID has not been created yet." << endl;
+                }
+            } else if(inpv[1] == "pagetable" && inpv.size() == 3) {
+                if(isNumber(inpv[2]) && inpv[2].size() <= 9 && processTable.table.count(stoi(inpv[2])) == 1) {
+                    printPageTable(stoi(inpv[2]));
+                } else {
+                    cout << "The provided PID has not been created yet." << endl;
+                }
+            } else if(inpv[1] == "numa" && inpv.size() == 2) {
+                printNuma();
+            } else if(inpv[1] == "reclaim" && inpv.size() == 2) {
+                printReclaim();
+            } else if(inpv[1] == "quota" && inpv.size() == 2) {
+                printQuota();
+            } else if(inpv[1] == "pagecache" && inpv.size() == 2) {
+                printPageCache();
             } else if(inpv[1] == "processes" && inpv.size() == 2){
                 if(processTable.table.size()==0) {
                     cout << "There are no processes currently running" << endl;
@@ -210,7 +683,7 @@ int main(int argc, char *argv[]) {
         } else if(inpv[0] == "allocate") {
             if(inpv.size() != 5) {
                 cout<< "allocate requires 5 arguments"<<endl;
-            } else if(!isNumber(inpv[1]) && !isNumber(inpv[4])){
+            } else if(!isNumber(inpv[1]) || !isNumber(inpv[4]) || inpv[1].size() > 9 || inpv[4].size() > 9){
                 cout << "The inputted PID and amount must be an integer" << endl;
             } else {
                 if(stoi(inpv[4])>0) {
@@ -362,12 +835,120 @@ int main(int argc, char *argv[]) {
             if(isNumber(inpv[1])){
                 if(findExistingVariable(stoi(inpv[1]), inpv[2])){
                     freeVariable(stoi(inpv[1]), inpv[2]);
+                    compactIfFragmented(stoi(inpv[1]));
                 } else {
                     cout << "The provided PID and Variable has not been created yet." << endl;
                 }
             } else {
                 cout << "The provided PID must be an integer" << endl;
             }
+        } else if(inpv[0] == "realloc") {
+            if(inpv.size() != 4) {
+                cout << "realloc requires 3 arguments" << endl;
+            } else if(!isNumber(inpv[1]) || !isNumber(inpv[3]) || inpv[1].size() > 9 || inpv[3].size() > 9) {
+                cout << "The inputted PID and amount must be an integer" << endl;
+            } else if(stoi(inpv[3]) <= 0) {
+                cout << "The amount must be greater than 0" << endl;
+            } else if(!findExistingVariable(stoi(inpv[1]), inpv[2])) {
+                cout << "The provided PID and Variable has not been created yet." << endl;
+            } else {
+                reallocVariable(stoi(inpv[1]), inpv[2], stoi(inpv[3]));
+                compactIfFragmented(stoi(inpv[1]));
+            }
+        } else if(inpv[0] == "compact") {
+            if(inpv.size() != 2) {
+                cout << "compact requires 1 argument" << endl;
+            } else if(!isNumber(inpv[1]) || inpv[1].size() > 9) {
+                cout << "The provided PID must be an integer" << endl;
+            } else if(processTable.table.count(stoi(inpv[1])) == 0) {
+                cout << "The provided PID has not been created yet." << endl;
+            } else {
+                compactProcess(stoi(inpv[1]));
+            }
+        } else if(inpv[0] == "quota") {
+            if(inpv.size() != 4) {
+                cout << "quota requires 3 arguments" << endl;
+            } else if(!isNumber(inpv[1]) || !isNumber(inpv[3]) || inpv[1].size() > 9 || inpv[3].size() > 9) {
+                cout << "The provided PID and page count must be integers" << endl;
+            } else if(processTable.table.count(stoi(inpv[1])) == 0) {
+                cout << "The provided PID has not been created yet." << endl;
+            } else if(inpv[2] != "rss" && inpv[2] != "swap") {
+                cout << "The quota kind must be rss or swap" << endl;
+            } else {
+                setQuota(stoi(inpv[1]), inpv[2], stoi(inpv[3]));
+            }
+        } else if(inpv[0] == "map") {
+            if(inpv.size() < 4 || inpv.size() > 6) {
+                cout << "map requires 3 to 5 arguments" << endl;
+            } else if(!isNumber(inpv[1]) || (inpv.size() > 4 && (!isNumber(inpv[4]) || inpv[4].size() > 18))
+                      || (inpv.size() > 5 && (!isNumber(inpv[5]) || inpv[5].size() > 18))) {
+                cout << "The provided PID, offset and length must be integers" << endl;
+            } else if(!findExistingPID(stoi(inpv[1]))) {
+                cout << "The provided PID has not been created yet." << endl;
+            } else if(findExistingVariable(stoi(inpv[1]), inpv[2])) {
+                cout << "There is already a variable with that name that exists with the given PID" << endl;
+            } else {
+                long long offset = inpv.size() > 4 ? stoll(inpv[4]) : 0;
+                long long length = inpv.size() > 5 ? stoll(inpv[5]) : -1;
+                mapFile(stoi(inpv[1]), inpv[2], inpv[3], offset, length);
+            }
+        } else if(inpv[0] == "advise") {
+            if(inpv.size() != 4) {
+                cout << "advise requires 3 arguments" << endl;
+            } else if(!isNumber(inpv[1])) {
+                cout << "The provided PID must be an integer" << endl;
+            } else if(!findExistingVariable(stoi(inpv[1]), inpv[2])) {
+                cout << "The provided PID and Variable has not been created yet." << endl;
+            } else if(inpv[3] != "populate" && inpv[3] != "willneed" && inpv[3] != "dontneed" && inpv[3] != "cold"
+                      && inpv[3] != "normal") {
+                cout << "The advice must be populate, willneed, dontneed, cold or normal" << endl;
+            } else {
+                adviseVariable(stoi(inpv[1]), inpv[2], inpv[3]);
+            }
+        } else if(inpv[0] == "generate") {
+            if(inpv.size() < 3) {
+                cout << "generate requires a seed and a number of operations" << endl;
+            } else if(!isNumber(inpv[1]) || !isNumber(inpv[2]) || inpv[1].size() > 18 || inpv[2].size() > 18) {
+                cout << "The seed and number of operations must be integers" << endl;
+            } else {
+                WorkloadConfig config;
+                config.seed = stoull(inpv[1]);
+                config.operations = stoll(inpv[2]);
+                config.addressBits = commandInput.addressBits;
+                bool valid = true;
+                for(size_t i=3; i<inpv.size() && valid; i++) {
+                    size_t equals = inpv[i].find('=');
+                    if(equals == string::npos) {
+                        cout << "Workload options are written as <name>=<value>" << endl;
+                        valid = false;
+                    } else {
+                        valid = setWorkloadOption(config, inpv[i].substr(0, equals), inpv[i].substr(equals + 1));
+                    }
+                }
+                if(valid) {
+                    runWorkload(config);
+                }
+            }
+        } else if(inpv[0] == "save") {
+            if(inpv.size() != 2) {
+                cout << "save requires one argument" << endl;
+            } else {
+                saveSnapshot(inpv[1]);
+            }
+        } else if(inpv[0] == "load") {
+            if(inpv.size() != 2) {
+                cout << "load requires one argument" << endl;
+            } else {
+                loadSnapshot(inpv[1]);
+            }
+        } else if(inpv[0] == "config") {
+            if(inpv.size() == 1) {
+                printConfig();
+            } else if(inpv.size() == 3) {
+                setConfig(inpv[1], inpv[2]);
+            } else {
+                cout << "config takes no arguments or a name and a value" << endl;
+            }
         } else {
             cout << input << " :: invalid input" << endl;
         }
@@ -415,18 +996,28 @@ void takeCommand(int argc, char *argv[]) {
     }
 }
 
-void createProcess(){
-    Process *process = new Process;
+void createProcess(int addressBits, int numaNode, int numaPolicy){
+    int code = rand()% 14337 + 2048; //2048-16384
+    int globals = rand()% 1025; //0-1024
+    //text, globals and stack plus the page the stack ends in
+    if(!reserveMemory(-1, (code + globals + Process().stack) / commandInput.pageSize + 2)) {
+        return;
+    }
+    Process *process = acquireProcess();
     process->pid = mainInfo.currentPID;
     mainInfo.currentPID++;
-    process->code = rand()% 14337 + 2048; //2048-16384
-    process->globals= rand()% 1025; //0-1024
+    process->addressBits = addressBits;
+    process->pages = (1LL << addressBits) / commandInput.pageSize;
+    process->numaNode = numaNode;
+    process->numaPolicy = numaPolicy;
+    process->code = code;
+    process->globals= globals;
 
     MMUObject freeSpace;
     freeSpace.name = "freeSpace";
     freeSpace.pid = process->pid;
     freeSpace.address = 0;
-    freeSpace.size = 2097152;
+    freeSpace.size = 1LL << addressBits;
     freeSpace.typeCode = 0;
     freeSpace.key = to_string(freeSpace.pid) + freeSpace.name + to_string(freeSpace.address);
     mmuTable.table.insert(std::pair<string, MMUObject>(freeSpace.key,freeSpace));
@@ -435,21 +1026,20 @@ void createProcess(){
     //pages and their frames should NOT be initialized UNLESS they're getting data
 
     createPage(process);
-    process->totalPageRemainSpace = 2097152;
+    //registered before any page gets a frame so eviction can find its owner
+    processTable.table[process->pid] = process;
+    process->totalPageRemainSpace = 1LL << addressBits;
     process->currentPage = process->pageTable[0];
-    process->currentPage.frameNumber = lowestFrameNum();
-    int framesUsed = mainInfo.frame[0]-(mainInfo.frame.size()-1);
-    //assigning frame number
-    if(commandInput.pageSize * process->currentPage.frameNumber >= 67108864) {
-        //if the amount of frames in use is more than there are in RAM
-        if(commandInput.pageSize * framesUsed <= 536870912){
-            //this should actually only happen if the frame in question is in memory
-            switchMem(&(process->currentPage),process->currentPage.frameNumber);
-        } else {
-            //TRYING TO USE MORE MEM THAN AVAILABLE
-            exit(0);
-        }
+    process->tailSpace = commandInput.pageSize;
+    //assigning frame number, evicting to swap when RAM is full
+    if(pageFrameAddress(process, 0) == NULL) {
+        cout << "Not enough memory to create a process" << endl;
+        terminatePID(process->pid);
+        return;
     }
+    process->currentPage.referenced = 1; //a fresh page should not be the next eviction victim
+    process->pageTable[0] = process->currentPage;
+    frameTable.table[process->currentPage.frameNumber] = process->currentPage;
 
     MMUObject codeMMU;
     codeMMU.pid = process->pid;
@@ -464,7 +1054,10 @@ void createProcess(){
 
     mmuTable.table.insert(std::pair<string, MMUObject>(codeMMU.key,codeMMU));
 
-    pageHandler(process,codeMMU);
+    if(!pageHandler(process,std::move(codeMMU))) {
+        terminatePID(process->pid);
+        return;
+    }
 
     MMUObject globalMMU;
     globalMMU.pid = process->pid;
@@ -479,7 +1072,10 @@ void createProcess(){
 
     mmuTable.table.insert(std::pair<string, MMUObject>(globalMMU.key,globalMMU));
 
-    pageHandler(process,globalMMU);
+    if(!pageHandler(process,std::move(globalMMU))) {
+        terminatePID(process->pid);
+        return;
+    }
 
     MMUObject stackMMU;
     stackMMU.pid = process->pid;
@@ -494,9 +1090,11 @@ void createProcess(){
 
     mmuTable.table.insert(std::pair<string, MMUObject>(stackMMU.key,stackMMU));
 
-    pageHandler(process,stackMMU);
+    if(!pageHandler(process,std::move(stackMMU))) {
+        terminatePID(process->pid);
+        return;
+    }
 
-    processTable.table[process->pid] = process;
     cout << process->pid << endl;
 }
 
@@ -508,25 +1106,34 @@ void allocateVariable(int pid, string name, string type, int amount) {
         stackMMU.size = amount;
         stackMMU.typeCode = 1;
     } else if(type == "short") {
-        stackMMU.size = amount*2;
+        stackMMU.size = amount*2LL;
         stackMMU.typeCode = 2;
     } else if(type == "int") {
-        stackMMU.size = amount*4;
+        stackMMU.size = amount*4LL;
         stackMMU.typeCode = 3;
     } else if(type == "double") {
-        stackMMU.size = amount*8;
+        stackMMU.size = amount*8LL;
         stackMMU.typeCode = 4;
     } else if(type == "long") {
-        stackMMU.size = amount*8;
+        stackMMU.size = amount*8LL;
         stackMMU.typeCode = 5;
     } else {
-        stackMMU.size = amount*4;
+        stackMMU.size = amount*4LL;
         stackMMU.typeCode = 6;
     }
     stackMMU.set = false;
 
     stackMMU.key = to_string(stackMMU.pid) + stackMMU.name;
-    string freeSpaceMMUKey = findFreeSpaceMMU(stackMMU.size, stackMMU.pid);
+    Process *currentProcess = processTable.table[pid];
+    //check everything before the virtual range is carved out of free space
+    string freeSpaceMMUKey = stackMMU.size > INT_MAX ? "N/A" : findFreeSpaceMMU(stackMMU.size, stackMMU.pid);
+    if(freeSpaceMMUKey == "N/A" || stackMMU.size > currentProcess->totalPageRemainSpace) {
+        cout << "Process " << pid << " does not have enough free virtual memory for " << name << endl;
+        return;
+    }
+    if(!reserveMemory(pid, pagesNeeded(currentProcess, stackMMU.size))) {
+        return;
+    }
     stackMMU.address = mmuTable.table.at(freeSpaceMMUKey).address;
     mmuTable.table.at(freeSpaceMMUKey).address = stackMMU.address+stackMMU.size;
     mmuTable.table.at(freeSpaceMMUKey).size = mmuTable.table.at(freeSpaceMMUKey).size - stackMMU.size;
@@ -536,49 +1143,47 @@ void allocateVariable(int pid, string name, string type, int amount) {
 
     mmuTable.table.insert(std::pair<string, MMUObject>(stackMMU.key,stackMMU));
 
-    Process *currentProcess = processTable.table[pid];
-    pageHandler(currentProcess,stackMMU);
-
-    processTable.table[currentProcess->pid] = currentProcess;
-
-    MMUObject mmu = mmuTable.table[stackMMU.key];
+    if(!pageHandler(currentProcess,std::move(stackMMU))) {
+        //hand back whatever was placed before memory ran out
+        freeVariable(pid, name);
+        return;
+    }
 
-    cout << mmu.physicalAddr << endl;
+    cout << mmuTable.table.at(to_string(pid)+name).physicalAddr << endl;
 }
 
 string findFreeSpaceMMU(int size, int pid) {
-    //found a map iterator
-    //https://stackoverflow.com/questions/26281979/c-loop-through-map
-    int lowest = -1;
-    string ret;
-    for (auto const& loc : mmuTable.table)
-    {
-        //loc.first string (key)
-        //loc.second string's value
-        if(loc.second.name=="freeSpace" && loc.second.size>=size && pid == loc.second.pid) {
-            lowest = loc.second.address;
-            ret = loc.second.key;
-        }
-    }
-    if(lowest == -1){
-        return "N/A";
-    }
-    for (auto const& loc : mmuTable.table)
+    //the lowest free extent of the process that can hold size bytes
+    long long lowest = -1;
+    string ret = "N/A";
+    for (auto it = mmuFirst(pid), end = mmuPast(pid); it != end; ++it)
     {
-        //loc.first string (key)
-        //loc.second string's value
-        if(loc.second.name=="freeSpace" && loc.second.size>=size && pid == loc.second.pid && loc.second.address < lowest) {
-            lowest = loc.second.address;
-            ret = loc.second.key;
+        if(it->second.name=="freeSpace" && it->second.size>=size && pid == it->second.pid
+           && (lowest == -1 || it->second.address < lowest)) {
+            lowest = it->second.address;
+            ret = it->second.key;
         }
     }
     return ret;
 
 }
 
+//mmuTable keys start with the pid, so the entries of a process sit together from
+//mmuFirst(pid) up to mmuPast(pid). Pids that begin with the same digits can share the
+//range, the pid of an entry tells them apart.
+map<string, MMUObject>::iterator mmuFirst(int pid) {
+    return mmuTable.table.lower_bound(to_string(pid));
+}
+
+map<string, MMUObject>::iterator mmuPast(int pid) {
+    string bound = to_string(pid);
+    bound.back()++; //every key starting with the digits of pid sorts below this
+    return mmuTable.table.lower_bound(bound);
+}
+
 void printMMU() {
-    printf("|%4s  | %13s | %11s | %4s \n", "PID", "Variable Name", "Virtual Addr", "Size");
-    printf("+------+---------------+--------------+------------\n");
+    printf("|%4s  | %13s | %14s | %4s \n", "PID", "Variable Name", "Virtual Addr", "Size");
+    printf("+------+---------------+----------------+------------\n");
     //Looked up how to change map to vector, for sorting purposes
     //https://stackoverflow.com/questions/5056645/sorting-stdmap-using-value
     vector<std::pair<string, MMUObject>> pairs;
@@ -590,7 +1195,7 @@ void printMMU() {
     sort( pairs.begin(), pairs.end(), compareEntry );
     for(int i=0; i<pairs.size(); i++) {
         if(pairs[i].second.name!="freeSpace") {
-            printf("| %4d | %13s | 0x%08x | %10d \n", pairs[i].second.pid, pairs[i].second.name.c_str(), pairs[i].second.address, pairs[i].second.size);
+            printf("| %4d | %13s | 0x%012llx | %10lld \n", pairs[i].second.pid, pairs[i].second.name.c_str(), pairs[i].second.address, pairs[i].second.size);
         }
     }
 
@@ -638,11 +1243,16 @@ int findExistingVariableType(int pid, string name) {
 }
 
 void terminatePID(int pid){
+    auto processIt = processTable.table.find(pid);
+    Process *process = processIt == processTable.table.end() ? NULL : processIt->second;
     //different type of loop to go trough all entries of map, this is necessary
     //because the old loop
     //https://stackoverflow.com/questions/8234779/how-to-remove-from-a-map-while-iterating-it
-    for (auto it = mmuTable.table.begin(); it != mmuTable.table.end(); ) {
+    for (auto it = mmuFirst(pid), end = mmuPast(pid); it != end; ) {
         if (it->second.pid == pid) {
+            if(it->second.mapping != -1 && process != NULL) {
+                unmapRegion(process, it->second);
+            }
             it = mmuTable.table.erase(it);
         } else {
             ++it;
@@ -654,25 +1264,59 @@ void terminatePID(int pid){
     processTable.table.erase(pid);
 
     //remove from frameTable and push back the free frameNumber
-    for(auto const& loc : frameTable.table){
-        if(loc.second.pid == pid){
-            mainInfo.frame.push_back(loc.first);
-            frameTable.table.erase(loc.first);
+    for (auto it = frameTable.table.begin(); it != frameTable.table.end(); ) {
+        if(it->second.pid == pid){
+            releaseFrame(it->first);
+            it = frameTable.table.erase(it);
+        } else {
+            ++it;
         }
     }
+
+    forgetColdPages(pid);
+
+    //release the swap slots and pool entries of pages that were swapped out
+    auto swapIt = swapSpace.swapMap.lower_bound(make_pair(pid, INT_MIN));
+    while(swapIt != swapSpace.swapMap.end() && swapIt->first.first == pid) {
+        int pageNumber = swapIt->first.second;
+        ++swapIt;
+        releaseSwapSlot(pid, pageNumber);
+    }
+    auto poolIt = zswapPool.entries.lower_bound(make_pair(pid, INT_MIN));
+    while(poolIt != zswapPool.entries.end() && poolIt->first.first == pid) {
+        int pageNumber = poolIt->first.second;
+        ++poolIt;
+        releaseSwappedPage(pid, pageNumber);
+    }
+
+    if(process != NULL) {
+        releaseProcess(process);
+    }
 }
 
 void freeVariable(int pid, string name) {
-    MMUObject mmu = mmuTable.table[to_string(pid)+name];
+    auto mmuIt = mmuTable.table.find(to_string(pid)+name);
+    MMUObject mmu = std::move(mmuIt->second);
+    mmuTable.table.erase(mmuIt);
+    releaseVirtualRange(pid, mmu.address, mmu.size);
+
+    Process *process = processTable.table[pid];
+    if(mmu.pinned) {
+        pinPages(process, mmu, -1);
+    }
+    freeFromPage(process,mmu);
+}
+
+//turns a virtual range back into freeSpace, merged with the free extents around it
+void releaseVirtualRange(int pid, long long address, long long size) {
     MMUObject freeSpace;
     freeSpace.name = "freeSpace";
     freeSpace.pid = pid;
-    freeSpace.address = mmuTable.table.at(to_string(pid)+name).address;
-    freeSpace.size = mmuTable.table.at(to_string(pid)+name).size;
+    freeSpace.address = address;
+    freeSpace.size = size;
     freeSpace.typeCode = 0;
     freeSpace.key = to_string(pid) + freeSpace.name + to_string(freeSpace.address);
-    mmuTable.table.erase(to_string(pid)+name);
-    for (auto it = mmuTable.table.begin(); it != mmuTable.table.end(); ) {
+    for (auto it = mmuFirst(pid), end = mmuPast(pid); it != end; ) {
         //loc.first string (key)
         //loc.second string's value
         if(it->second.name=="freeSpace" && freeSpace.pid == it->second.pid) {
@@ -691,39 +1335,55 @@ void freeVariable(int pid, string name) {
         }
     }
     mmuTable.table.insert(std::pair<string, MMUObject>(freeSpace.key,freeSpace));
-
-    Process *process = processTable.table[pid];
-    freeFromPage(process,mmu);
 }
 
 void createPage(Process *process){
-    //new process with no page
-    while(process->amountPageUsed < process->pages) {
-        PageUnit page;
-        page.pid = process->pid;
-        page.pageSize = commandInput.pageSize;
-        page.freeSpace = page.pageSize;
-        page.pageNumber = process->amountPageUsed;
-        process->amountPageUsed++;
-        page.frameNumber = -1; //marked for empty page
-        process->pageTable[page.pageNumber] = page;
-    }
+    //new process with no page, the page table fills itself in as pages get used
+    process->pageTable.init(process->pid, process->pages);
 }
 
-void pageHandler(Process *process, MMUObject mmu){
-    int remainData = mmu.size;
+//places mmu in the pages of the process, false if memory or page space ran out part
+//way, in which case the pieces placed so far are still recorded in the mmuTable
+bool pageHandler(Process *process, MMUObject mmu){
+    int remainData = (int)mmu.size;
     //check if there is enough space in all pages
     if(remainData > process->totalPageRemainSpace){
         cout << "no more space in page" << endl;
-        return ;
+        return false;
     }
 
-    while(process->currentPage.freeSpace == 0){
-        process->currentPage = process->pageTable[(process->currentPage.pageNumber+1)%process->pages];
+    //pageInfo is ordered by page number, so the pieces have to go on increasing pages.
+    //When the empty pages after the current one cannot take the rest, start again from
+    //the lowest empty page instead of wrapping around, the tail of the current page is
+    //left as a hole.
+    int pageSize = commandInput.pageSize;
+    int spillPages = (remainData - process->tailSpace + pageSize - 1) / pageSize;
+    if(spillPages > 0 && emptyPagesAfter(process, process->currentPage.pageNumber, spillPages) < spillPages) {
+        int needed = (remainData + pageSize - 1) / pageSize;
+        if(emptyPagesAfter(process, -1, needed) < needed) {
+            cout << "no more space in page" << endl;
+            return false;
+        }
+        //an emptied current page kept its frame, once it is no longer current
+        //freeFromPage hands the frame back
+        MMUObject left;
+        left.pageInfo[process->currentPage.pageNumber] = 0;
+        process->currentPage.pageNumber = -1;
+        process->tailSpace = 0;
+        freeFromPage(process, left);
+    }
+    if(process->tailSpace == 0 && !nextEmptyPage(process)) {
+        cout << "no more space in page" << endl;
+        return false;
+    }
+    //the page may have been swapped out since the last allocation
+    if(pageFrameAddress(process, process->currentPage.pageNumber) == NULL) {
+        cout << "Out of memory while placing " << mmu.name << endl;
+        return false;
     }
 
     //the free space start from freeAddr
-    int freeAddr = commandInput.pageSize - process->currentPage.freeSpace;
+    int freeAddr = commandInput.pageSize - process->tailSpace;
 
     mmu.pageNumber = process->currentPage.pageNumber;
     mmu.frameNumber = process->currentPage.frameNumber;
@@ -732,55 +1392,74 @@ void pageHandler(Process *process, MMUObject mmu){
     while(remainData > 0){
         //mmu pageInfo change here,
         //for one mmu, the pageInfo map tells us how much data we stored in which page
-        if(remainData < process->currentPage.freeSpace){
-            //if the remainData is smaller, the page could handle the data and store data
-            //it means the while loop will stop
-            mmu.pageInfo[process->currentPage.pageNumber] = remainData;
-        }else{
-            //if the freespace is smaller, the page could not store that much data,
-            //it will only store whatever amount of free space it owns, and keep running the loop
-            mmu.pageInfo[process->currentPage.pageNumber] = process->currentPage.freeSpace;
-        }
+        //the page stores as much of the data as its tail can hold
+        int stored = min(remainData, process->tailSpace);
+        mmu.pageInfo[process->currentPage.pageNumber] = stored;
+        remainData -= stored;
 
-        remainData -= process->currentPage.freeSpace;
+        process->tailSpace -= stored;
+        process->currentPage.freeSpace -= stored;
+        process->totalPageRemainSpace -= stored;
+        frameTable.table[process->currentPage.frameNumber] = process->currentPage;
+        process->pageTable[process->currentPage.pageNumber] = process->currentPage;
 
-        if(remainData < 0){
-            process->totalPageRemainSpace -= remainData *(-1);
-            process->currentPage.freeSpace = remainData *(-1);
-            frameTable.table[process->currentPage.frameNumber] = process->currentPage;
-            process->pageTable[process->currentPage.pageNumber] = process->currentPage;
-        }else{
-            process->totalPageRemainSpace -= process->currentPage.freeSpace;
-            process->currentPage.freeSpace = 0;
-            frameTable.table[process->currentPage.frameNumber] = process->currentPage;
-            process->pageTable[process->currentPage.pageNumber] = process->currentPage;
+        if(remainData > 0){
             //move to next page
-            //check if there is enough space in all pages
-            while(process->currentPage.freeSpace == 0) {
-                process->currentPage = process->pageTable[(process->currentPage.pageNumber + 1) % process->pages];
+            if(!nextEmptyPage(process)) {
+                cout << "no more space in page" << endl;
+                mmuTable.table[mmu.key] = std::move(mmu);
+                return false;
             }
-            process->currentPage.frameNumber = lowestFrameNum();
-            int framesUsed = mainInfo.frame[0]-(mainInfo.frame.size()-1);
-            if(commandInput.pageSize * framesUsed >= 67108864) {
-                if(commandInput.pageSize * framesUsed <= 536870912) {
-
-                    switchMem(&(process->currentPage), process->currentPage.frameNumber);
-
-                } else {
-                    //TRYING TO USE MORE MEM THAN AVAILABLE
-                    exit(0);
-                }
+            if(pageFrameAddress(process, process->currentPage.pageNumber) == NULL) {
+                cout << "Out of memory while placing " << mmu.name << endl;
+                mmuTable.table[mmu.key] = std::move(mmu);
+                return false;
             }
+            process->currentPage.referenced = 1; //a fresh page should not be the next eviction victim
+            process->pageTable[process->currentPage.pageNumber] = process->currentPage;
+            frameTable.table[process->currentPage.frameNumber] = process->currentPage;
         }
     }
 
     //update the mmu in the mmuTable
-    mmuTable.table[mmu.key] = mmu;
+    mmuTable.table[mmu.key] = std::move(mmu);
+
+    return true;
+}
 
+//counts the empty pages numbered above pageNumber, stopping once wanted are found
+int emptyPagesAfter(Process *process, int pageNumber, int wanted) {
+    int found = 0;
+    for(int i = pageNumber + 1; i < process->pages && found < wanted; i++) {
+        const PageUnit &page = process->pageTable[i];
+        if(page.freeSpace == page.pageSize && page.mapping == -1) {
+            found++;
+        }
+    }
+    return found;
+}
 
+//makes the next page with nothing on it the current page, looking at every page at
+//most once. Pages with holes are passed over, their free bytes sit between live data.
+bool nextEmptyPage(Process *process) {
+    int pageNumber = process->currentPage.pageNumber;
+    for(int step = 0; step < process->pages; step++) {
+        pageNumber = (pageNumber + 1) % process->pages;
+        const PageUnit &page = process->pageTable[pageNumber];
+        if(page.freeSpace == page.pageSize && page.mapping == -1) {
+            process->currentPage = page;
+            process->tailSpace = page.pageSize;
+            return true;
+        }
+    }
+    return false;
 }
 
-void freeFromPage(Process *process, MMUObject mmu){
+void freeFromPage(Process *process, const MMUObject& mmu){
+    if(mmu.mapping != -1) {
+        unmapRegion(process, mmu);
+        return;
+    }
 
     int pageNum;
     PageUnit page;
@@ -791,16 +1470,33 @@ void freeFromPage(Process *process, MMUObject mmu){
         pageNum = loc.first;
         sizeIn = loc.second;
 
-        page = process->pageTable[pageNum];
+        //currentPage holds the up to date freeSpace of its page
+        page = pageNum == process->currentPage.pageNumber ? process->currentPage : process->pageTable[pageNum];
         page.freeSpace += sizeIn;
         process->totalPageRemainSpace += sizeIn;
+        if(pageNum == process->currentPage.pageNumber) {
+            process->currentPage.freeSpace = page.freeSpace;
+            if(page.freeSpace == page.pageSize) {
+                process->tailSpace = page.pageSize; //nothing left on it, fill it again from the start
+            }
+        }
 
         //if the page is empty after freeing, remove from frameTable
-        if(page.freeSpace == page.pageSize){
-            int frameNumber = page.frameNumber;
-            frameTable.table.erase(frameNumber);
+        //the current page keeps its frame, pageHandler is still filling it
+        if(page.freeSpace == page.pageSize && pageNum != process->currentPage.pageNumber){
+            if(page.inMem == 1) {
+                releaseSwappedPage(process->pid, pageNum);
+                process->swappedPages--;
+            } else if(page.frameNumber != -1) { //dontneed may have taken the frame already
+                frameTable.table.erase(page.frameNumber);
+                releaseFrame(page.frameNumber);
+                process->residentPages--;
+            }
             page.frameNumber = -1; // means the page is empty and removed from the frameTable
-            mainInfo.frame.push_back(frameNumber);
+            page.inMem = 0;
+            page.referenced = 0;
+            page.dirty = 0;
+            page.lastAccess = 0;
         }
 
         process->pageTable[pageNum] = page;
@@ -810,56 +1506,52 @@ void freeFromPage(Process *process, MMUObject mmu){
 
 }
 
-void switchMem(PageUnit* page, int fnumber) {
-    int swp = 0;
-    fstream fmem;
-    fmem.open("memfile.txt");
-    long pos = fmem.tellp() + long(fnumber*commandInput.pageSize);
-    page->inMem = 0;
-    for (auto& processLoc : processTable.table) {
-        if (swp == 0) {
-            for (auto& pageLoc : processLoc.second->pageTable) {
-                if (pageLoc.second.inMem == 0) {
-                    vector<std::pair<string, MMUObject>> pairs;
-                    for (auto itr = mmuTable.table.begin(); itr != mmuTable.table.end(); ++itr) {
-                        pairs.push_back(*itr);
-                    }
-                    //excerpted code from MMUprint
-                    sort( pairs.begin(), pairs.end(), compareEntry );
-                    for(int i=0; i<pairs.size(); i++) {
-                        fmem.seekp(pos);
-                        if(pairs[i].second.pid ==pageLoc.second.pid) {
-                            fmem<<pairs[i].second.address;
-                        }
-                    }
-                    fmem.close();
-                    //write into "mem" starting at the index that the current page was taken out of (e.g. frame * size)
-                    page->frameNumber = pageLoc.second.frameNumber;
-                    pageLoc.second.frameNumber = fnumber;
-                    pageLoc.second.inMem = 1;
-                    break;
-                }
-            }
-        }
+bool switchMem(int pid, int pageNumber, int ownerPid) {
+    //evicts one resident page other than (pid, pageNumber), belonging to ownerPid unless
+    //that is -1, to a swap slot and puts its frame back on the free list, false if
+    //nothing can be evicted or swap is full. Clean file pages go first when no owner
+    //is given, dropping them costs no swap I/O
+    if(ownerPid == -1 && pageCacheDrop()) {
+        return true;
     }
-
-} // switches input page onto RAM, writes first page already on RAM onto file, switches tag back
+    int victimFrame = chooseVictimFrame(pid, pageNumber, ownerPid);
+    if(victimFrame == -1) {
+        return false;
+    }
+    Process *owner = processTable.table[frameTable.table[victimFrame].pid];
+    PageUnit &victim = owner->pageTable[frameTable.table[victimFrame].pageNumber];
+    uint8_t *frameAddr = mainInfo.mem + (long)victimFrame * commandInput.pageSize;
+    if(!swapOutPage(victim.pid, victim.pageNumber, frameAddr)) {
+        return false;
+    }
+    memset(frameAddr, 0, commandInput.pageSize);
+    victim.frameNumber = -1;
+    victim.inMem = 1;
+    victim.referenced = 0;
+    victim.dirty = 0;
+    syncCurrentPage(owner, victim);
+    owner->residentPages--;
+    owner->swappedPages++;
+    frameTable.table.erase(victimFrame);
+    releaseFrame(victimFrame);
+    return true;
+} // moves a page in RAM out to the compressed pool or swap and frees its frame
 
 void printPage(){
-    printf("|%4s  | %11s | %12s \n", "PID", "Page Number", "Frame Number");
-    printf("+------+-------------+--------------\n");
+    printf("|%4s  | %11s | %12s | %9s \n", "PID", "Page Number", "Frame Number", "Swap Slot");
+    printf("+------+-------------+--------------+-----------\n");
     for (auto const& processLoc : processTable.table) {
         //go through processTable
-        for (auto const& pageLoc : processLoc.second->pageTable) {
+        for (PageUnit *page : processLoc.second->pageTable.entries()) {
             //go through pageTable in every process
-            if (pageLoc.second.frameNumber != -1) {
-                if(pageLoc.second.inMem != 1) {
-                    printf("\x1b[31m" "| %4d | %11d | %12d  \n" "\x1b[0m", processLoc.second->pid, pageLoc.second.pageNumber,
-                           pageLoc.second.frameNumber);
-                }else {
-                    printf("| %4d | %11d | %12d  \n", processLoc.second->pid, pageLoc.second.pageNumber,
-                           pageLoc.second.frameNumber);
-                }
+            if(page->inMem == 1) {
+                auto slotIt = swapSpace.swapMap.find(make_pair(processLoc.second->pid, page->pageNumber));
+                string slot = slotIt == swapSpace.swapMap.end() ? "zswap" : to_string(slotIt->second);
+                printf("\x1b[31m" "| %4d | %11d | %12s | %9s \n" "\x1b[0m", processLoc.second->pid, page->pageNumber,
+                       "-", slot.c_str());
+            } else if (page->frameNumber != -1) {
+                printf("| %4d | %11d | %12d | %9s \n", processLoc.second->pid, page->pageNumber,
+                       page->frameNumber, page->mapping != -1 ? "file" : "-");
             }
         }
     }
@@ -872,96 +1564,120 @@ void printProcesses() {
 }
 
 void setValues(int pid, string name, int offset, vector<VariableObject> values) {
-    char *charPointer;
-    short *shortPointer;
-    int *intPointer;
-    double *doublePointer;
-    long long *longPointer;
-    float *floatPointer;
-    uint8_t *mem = mainInfo.mem;
-    MMUObject setMMUObject = mmuTable.table.at(to_string(pid)+name);
-    mmuTable.table.at(to_string(pid)+name).set = true;
-    int location = setMMUObject.physicalAddr + offset;
-    switch(values.at(0).typeCode){
-        case 1 : charPointer = (char*) (mem+location);
-            break;
-        case 2 : shortPointer = (short*) (mem+location);
-            break;
-        case 3 : intPointer = (int*) (mem+location);
-            break;
-        case 4 : doublePointer = (double*) (mem+location);
-            break;
-        case 5 : longPointer = (long long*) (mem+location);
-            break;
-        case 6 : floatPointer = (float*) (mem+location);
-            break;
-    }
+    //values are copied through the page table one element at a time, so an
+    //element that straddles two pages (or a swapped out page) still lands correctly
+    MMUObject &setMMUObject = mmuTable.table.at(to_string(pid)+name);
+    setMMUObject.set = true;
     for(int i=0; i<values.size(); i++){
         switch(values.at(0).typeCode){
-            case 1 : charPointer[i] = values.at(i).charValue;
+            case 1 : copyToVariable(setMMUObject, offset + i, (uint8_t*) &values.at(i).charValue, 1);
                 break;
-            case 2 : shortPointer[i*2] = values.at(i).shortValue;
+            case 2 : copyToVariable(setMMUObject, offset + i*2, (uint8_t*) &values.at(i).shortValue, 2);
                 break;
-            case 3 : intPointer[i*4] = values.at(i).intValue;
+            case 3 : copyToVariable(setMMUObject, offset + i*4, (uint8_t*) &values.at(i).intValue, 4);
                 break;
-            case 4 : doublePointer[i*8] = values.at(i).doubleValue;
+            case 4 : copyToVariable(setMMUObject, offset + i*8, (uint8_t*) &values.at(i).doubleValue, 8);
                 break;
-            case 5 : longPointer[i*8] = values.at(i).longValue;
+            case 5 : copyToVariable(setMMUObject, offset + i*8, (uint8_t*) &values.at(i).longValue, 8);
                 break;
-            case 6 : floatPointer[i*4] = values.at(i).floatValue;
+            case 6 : copyToVariable(setMMUObject, offset + i*4, (uint8_t*) &values.at(i).floatValue, 4);
                 break;
         }
     }
 }
 
-int lowestFrameNum(){
-    //the vector[0] is the main number to get the new frame number
-    //the rest numbers are the numbers which were used before, then put back to the vector
-    int min = mainInfo.frame[0];
-    int loc = 0;
-    for(int i=0;i<mainInfo.frame.size();i++){
-        if(mainInfo.frame[i] < min){
-            min = mainInfo.frame[i];
-            loc = i;
+//lowest free frame of the node, -1 if the node has none
+int lowestFrameNum(int node){
+    NumaNode &numaNode = numaInfo.nodes[node];
+    //frames that were used before and put back come first, they are below nextFresh
+    if(!numaNode.freed.empty()) {
+        int frame = *numaNode.freed.begin();
+        numaNode.freed.erase(numaNode.freed.begin());
+        return frame;
+    }
+    if(numaNode.nextFresh < numaNode.firstFrame + numaNode.frames) {
+        return numaNode.nextFresh++;
+    }
+    return -1;
+}
+
+//frames that can still be handed out without evicting anything
+int freeFrameCount() {
+    int count = 0;
+    for(size_t node = 0; node < numaInfo.nodes.size(); node++) {
+        count += nodeFreeFrames(node);
+    }
+    return count;
+}
+
+int nodeFreeFrames(int node) {
+    const NumaNode &numaNode = numaInfo.nodes[node];
+    return numaNode.firstFrame + numaNode.frames - numaNode.nextFresh + numaNode.freed.size();
+}
+
+//returns a free RAM frame for page pageNumber of pid, evicting another page to swap
+//when RAM is full, -1 if RAM is full and nothing could be swapped out. A cached frame
+//goes to the page cache, it is placed for pid but not charged to it.
+int allocateFrame(int pid, int pageNumber, bool cached) {
+    Process *process = processTable.table.count(pid) == 1 ? processTable.table[pid] : NULL;
+    if(process != NULL && !cached && process->rssQuota > 0 && process->residentPages >= process->rssQuota) {
+        //at its RSS quota a process has to swap out one of its own pages
+        if(!switchMem(pid, pageNumber, pid)) {
+            return -1;
+        }
+        oomInfo.quotaReclaims++;
+    }
+    while(freeFrameCount() == 0) {
+        //the reclaimer fell behind, evict inline, and if nothing can be evicted
+        //the OOM killer frees memory by terminating another process
+        if(switchMem(pid, pageNumber, -1)) {
+            reclaimInfo.directReclaims++;
+        } else if(!oomKill(pid, pid)) {
+            return -1;
         }
     }
-    if(min == mainInfo.frame[0]){
-        mainInfo.frame[0] += 1;
-    }else{
-        mainInfo.frame.erase(mainInfo.frame.begin()+loc);
+    int frame = takeFreeFrame(process, pageNumber, cached);
+    if(freeFrameCount() < reclaimInfo.lowWatermark) {
+        reclaimInfo.wake.notify_one();
+    }
+    return frame;
+}
+
+//hands out a free frame for pageNumber of process (NULL for none), at least one frame
+//has to be free
+int takeFreeFrame(Process *process, int pageNumber, bool cached) {
+    //the policy picks a node, a node without free frames falls back to the next one
+    int node = 0;
+    if(process != NULL) {
+        node = process->numaPolicy == NUMA_INTERLEAVE ? pageNumber % numaInfo.nodes.size() : process->numaNode;
+    }
+    while(nodeFreeFrames(node) == 0) {
+        node = (node + 1) % numaInfo.nodes.size();
+    }
+    int frame = lowestFrameNum(node);
+    if(process != NULL && !cached) {
+        process->residentPages++;
     }
-    return min;
+    return frame;
 }
 
 void printVariable(int pid, string name) {
     MMUObject variableMMUObject = mmuTable.table.at(to_string(pid)+name);
     //0=text/global/stack/freespace 1=char 2=short 3=int 4=double 5=long 6=float
-    char *charPointer;
-    short *shortPointer;
-    int *intPointer;
-    double *doublePointer;
-    long long *longPointer;
-    float *floatPointer;
+    VariableObject value;
     int amount = 0;
-    uint8_t *mem = mainInfo.mem;
     switch(variableMMUObject.typeCode){
-        case 1 : charPointer = (char*) (mem+variableMMUObject.physicalAddr);
-            amount = variableMMUObject.size;
+        case 1 : amount = variableMMUObject.size;
             break;
-        case 2 : shortPointer = (short*) (mem+variableMMUObject.physicalAddr);
-            amount = variableMMUObject.size/2;
+        case 2 : amount = variableMMUObject.size/2;
             break;
-        case 3 : intPointer = (int*) (mem+variableMMUObject.physicalAddr);
-            amount = variableMMUObject.size/4;
+        case 3 : amount = variableMMUObject.size/4;
             break;
-        case 4 : doublePointer = (double*) (mem+variableMMUObject.physicalAddr);
-            amount = variableMMUObject.size/8;
+        case 4 : amount = variableMMUObject.size/8;
             break;
-        case 5 : longPointer = (long long*) (mem+variableMMUObject.physicalAddr);
-            amount = variableMMUObject.size/8;
+        case 5 : amount = variableMMUObject.size/8;
             break;
-        case 6 : floatPointer = (float*) (mem+variableMMUObject.physicalAddr);
-            amount = variableMMUObject.size/4;
+        case 6 : amount = variableMMUObject.size/4;
             break;
     }
     
@@ -972,23 +1688,23 @@ void printVariable(int pid, string name) {
         }
         
         switch(variableMMUObject.typeCode){
-            case 1 : cout << *charPointer;
-                charPointer = (char*) (mem+variableMMUObject.physicalAddr + 1 + (1*i));
+            case 1 : copyFromVariable(variableMMUObject, i, (uint8_t*) &value.charValue, 1);
+                cout << value.charValue;
                 break;
-            case 2 : cout << *shortPointer;
-                shortPointer = (short*) (mem+variableMMUObject.physicalAddr + 2 + (2*i));
+            case 2 : copyFromVariable(variableMMUObject, i*2, (uint8_t*) &value.shortValue, 2);
+                cout << value.shortValue;
                 break;
-            case 3 : cout << *intPointer;
-                intPointer = (int*) (mem+variableMMUObject.physicalAddr + 4 + (4*i));
+            case 3 : copyFromVariable(variableMMUObject, i*4, (uint8_t*) &value.intValue, 4);
+                cout << value.intValue;
                 break;
-            case 4 : cout << *doublePointer;
-                doublePointer = (double*) (mem+variableMMUObject.physicalAddr + 8 + (8*i));
+            case 4 : copyFromVariable(variableMMUObject, i*8, (uint8_t*) &value.doubleValue, 8);
+                cout << value.doubleValue;
                 break;
-            case 5 : cout << *longPointer;
-                longPointer = (long long*)(mem+variableMMUObject.physicalAddr + 8+(8*i));
+            case 5 : copyFromVariable(variableMMUObject, i*8, (uint8_t*) &value.longValue, 8);
+                cout << value.longValue;
                 break;
-            case 6 : cout << *floatPointer;
-                floatPointer = (float*) (mem+variableMMUObject.physicalAddr + 4 + (4*i));
+            case 6 : copyFromVariable(variableMMUObject, i*4, (uint8_t*) &value.floatValue, 4);
+                cout << value.floatValue;
                 break;
         }
 
@@ -1012,3 +1728,3165 @@ string trimWhiteSpace(string str) {
     size_t last = str.find_last_not_of(' ');
     return str.substr(first, (last - first + 1));
 }
+
+//Snapshot layout (all integers little endian as laid out by the host):
+//  magic, version, page size
+//  mainInfo (currentPID) and the access clock, every NUMA node with its free frames
+//  frameTable, processTable (with every page table), mmuTable, mapped files and file mappings
+//  every RAM frame in the frameTable, written raw as <frameNumber><pageSize bytes>
+//  every swapped out page as <pid><pageNumber><pageSize bytes>
+void saveSnapshot(string fileName) {
+    FILE *file = fopen(fileName.c_str(), "wb");
+    if(file == NULL) {
+        cout << "Could not open " << fileName << " for writing" << endl;
+        return;
+    }
+    fwrite(SNAPSHOT_MAGIC, 1, sizeof(SNAPSHOT_MAGIC), file);
+    snapshotWriteValue<uint32_t>(file, SNAPSHOT_VERSION);
+    snapshotWriteValue<int32_t>(file, commandInput.pageSize);
+
+    snapshotWriteValue<int32_t>(file, mainInfo.currentPID);
+    snapshotWriteValue<int64_t>(file, accessInfo.clock);
+    snapshotWriteValue<uint32_t>(file, numaInfo.nodes.size());
+    for(size_t i = 0; i < numaInfo.nodes.size(); i++) {
+        const NumaNode &node = numaInfo.nodes[i];
+        //the page cache is not saved, its frames are written out as free
+        set<int> freed = node.freed;
+        for(auto const& loc : pageCache.entries) {
+            if(frameNode(loc.second.frame) == (int)i) {
+                freed.insert(loc.second.frame);
+            }
+        }
+        snapshotWriteValue<int32_t>(file, node.firstFrame);
+        snapshotWriteValue<int32_t>(file, node.frames);
+        snapshotWriteValue<int32_t>(file, node.nextFresh);
+        snapshotWriteValue<uint32_t>(file, freed.size());
+        for(int frame : freed) {
+            snapshotWriteValue<int32_t>(file, frame);
+        }
+    }
+
+    snapshotWriteValue<uint32_t>(file, frameTable.table.size());
+    for(auto const& loc : frameTable.table) {
+        snapshotWriteValue<int32_t>(file, loc.first);
+        snapshotWritePage(file, loc.second);
+    }
+
+    snapshotWriteValue<uint32_t>(file, processTable.table.size());
+    for(auto const& processLoc : processTable.table) {
+        Process *process = processLoc.second;
+        snapshotWriteValue<int32_t>(file, process->pid);
+        snapshotWriteValue<int32_t>(file, process->code);
+        snapshotWriteValue<int32_t>(file, process->globals);
+        snapshotWriteValue<int32_t>(file, process->addressBits);
+        snapshotWriteValue<int64_t>(file, process->totalPageRemainSpace);
+        snapshotWriteValue<int64_t>(file, process->pageTable.walks);
+        snapshotWriteValue<int64_t>(file, process->pageTable.walkSteps);
+        snapshotWriteValue<int64_t>(file, process->accesses);
+        snapshotWriteValue<int64_t>(file, process->faults);
+        snapshotWriteValue<int32_t>(file, process->rssQuota);
+        snapshotWriteValue<int32_t>(file, process->swapQuota);
+        snapshotWriteValue<int32_t>(file, process->numaNode);
+        snapshotWriteValue<int32_t>(file, process->numaPolicy);
+        snapshotWriteValue<int64_t>(file, process->localAccesses);
+        snapshotWriteValue<int64_t>(file, process->remoteAccesses);
+        snapshotWritePage(file, process->currentPage);
+        snapshotWriteValue<int32_t>(file, process->tailSpace);
+        vector<PageUnit*> pages = process->pageTable.entries();
+        snapshotWriteValue<uint32_t>(file, pages.size());
+        for(PageUnit *page : pages) {
+            snapshotWritePage(file, *page);
+        }
+    }
+
+    snapshotWriteValue<uint32_t>(file, mmuTable.table.size());
+    for(auto const& loc : mmuTable.table) {
+        const MMUObject& mmu = loc.second;
+        snapshotWriteString(file, loc.first);
+        snapshotWriteValue<int32_t>(file, mmu.pageNumber);
+        snapshotWriteValue<int32_t>(file, mmu.frameNumber);
+        snapshotWriteValue<uint8_t>(file, mmu.set);
+        snapshotWriteValue<int32_t>(file, mmu.pid);
+        snapshotWriteValue<int32_t>(file, mmu.typeCode);
+        snapshotWriteString(file, mmu.name);
+        snapshotWriteValue<int64_t>(file, mmu.address);
+        snapshotWriteValue<int64_t>(file, mmu.size);
+        snapshotWriteString(file, mmu.key);
+        snapshotWriteValue<int32_t>(file, mmu.physicalAddr);
+        snapshotWriteValue<int32_t>(file, mmu.mapping);
+        snapshotWriteValue<uint8_t>(file, mmu.pinned);
+        snapshotWriteValue<uint32_t>(file, mmu.pageInfo.size());
+        for(auto const& pageLoc : mmu.pageInfo) {
+            snapshotWriteValue<int32_t>(file, pageLoc.first);
+            snapshotWriteValue<int32_t>(file, pageLoc.second);
+        }
+    }
+
+    snapshotWriteValue<uint32_t>(file, pageCache.files.size());
+    for(auto const& loc : pageCache.files) {
+        snapshotWriteValue<int32_t>(file, loc.first);
+        snapshotWriteString(file, loc.second.path);
+    }
+    snapshotWriteValue<uint32_t>(file, pageCache.mappings.size());
+    for(auto const& loc : pageCache.mappings) {
+        snapshotWriteValue<int32_t>(file, loc.first);
+        snapshotWriteValue<int32_t>(file, loc.second.fileId);
+        snapshotWriteValue<int32_t>(file, loc.second.pid);
+        snapshotWriteValue<int32_t>(file, loc.second.firstPage);
+        snapshotWriteValue<int64_t>(file, loc.second.offset);
+        snapshotWriteValue<int64_t>(file, loc.second.length);
+    }
+
+    snapshotWriteValue<uint32_t>(file, frameTable.table.size());
+    for(auto const& loc : frameTable.table) {
+        snapshotWriteValue<int32_t>(file, loc.first);
+        fwrite(mainInfo.mem + (long)loc.first * commandInput.pageSize, 1, commandInput.pageSize, file);
+    }
+
+    //swapped pages may still sit in the write-back queue, swapReadSlot sees those too
+    vector<uint8_t> buffer(commandInput.pageSize);
+    snapshotWriteValue<uint32_t>(file, swapSpace.swapMap.size() + zswapPool.entries.size());
+    for(auto const& loc : swapSpace.swapMap) {
+        snapshotWriteValue<int32_t>(file, loc.first.first);
+        snapshotWriteValue<int32_t>(file, loc.first.second);
+        swapReadSlot(loc.second, buffer.data());
+        fwrite(buffer.data(), 1, commandInput.pageSize, file);
+    }
+    for(auto const& loc : zswapPool.entries) {
+        snapshotWriteValue<int32_t>(file, loc.first.first);
+        snapshotWriteValue<int32_t>(file, loc.first.second);
+        zswapDecompress(loc.second.data, buffer.data(), commandInput.pageSize);
+        fwrite(buffer.data(), 1, commandInput.pageSize, file);
+    }
+
+    bool failed = ferror(file);
+    if(fclose(file) != 0 || failed) {
+        cout << "Failed while writing snapshot " << fileName << endl;
+        return;
+    }
+    cout << "Saved " << processTable.table.size() << " processes and "
+         << frameTable.table.size() + swapSpace.swapMap.size() + zswapPool.entries.size()
+         << " pages to " << fileName << endl;
+}
+
+//The snapshot is mapped rather than read so that the raw frames can be copied
+//straight out of the page cache into mainInfo.mem. Everything is parsed into
+//temporaries first so a truncated or foreign file leaves the current state alone.
+void loadSnapshot(string fileName) {
+    int fd = open(fileName.c_str(), O_RDONLY);
+    if(fd < 0) {
+        cout << "Could not open " << fileName << " for reading" << endl;
+        return;
+    }
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size < (off_t)(sizeof(SNAPSHOT_MAGIC) + 8)) {
+        close(fd);
+        cout << fileName << " is not a snapshot file" << endl;
+        return;
+    }
+    void *mapped = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED) {
+        cout << "Could not map " << fileName << endl;
+        return;
+    }
+    madvise(mapped, info.st_size, MADV_SEQUENTIAL);
+
+    SnapshotReader reader;
+    reader.pos = (const uint8_t*) mapped;
+    reader.end = reader.pos + info.st_size;
+
+    vector<NumaNode> nodes;
+    FrameTable loadedFrames;
+    ProcessTable loadedProcesses;
+    MMUTable loadedMMU;
+    map<int, string> loadedFiles; //key: file id, value: path
+    map<int, FileMapping> loadedMappings;
+    int currentPID = 0;
+    long long accessClock = 0;
+    int pageSize = 0;
+    uint32_t count = 0;
+    uint32_t swappedCount = 0;
+    const uint8_t *framesStart = NULL;
+    int ramFrames = 0;
+    set<pair<int, int>> swappedKeys; //(pid, pageNumber) of every page the page tables say is swapped out
+
+    if(memcmp(reader.pos, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        cout << fileName << " is not a snapshot file" << endl;
+        goto unmap;
+    }
+    reader.pos += sizeof(SNAPSHOT_MAGIC);
+    if(snapshotReadValue<uint32_t>(reader) != SNAPSHOT_VERSION) {
+        cout << fileName << " was written by an incompatible version of the simulator" << endl;
+        goto unmap;
+    }
+    pageSize = snapshotReadValue<int32_t>(reader);
+    if(pageSize < 1024 || pageSize > 32768 || (pageSize & (pageSize - 1)) != 0) {
+        cout << fileName << " has an invalid page size" << endl;
+        goto unmap;
+    }
+    ramFrames = 67108864 / pageSize;
+
+    currentPID = snapshotReadValue<int32_t>(reader);
+    accessClock = snapshotReadValue<int64_t>(reader);
+    count = snapshotReadValue<uint32_t>(reader);
+    if(count < 1 || count > NUMA_MAX_NODES) {
+        reader.ok = false;
+    }
+    for(uint32_t i=0; i<count && reader.ok; i++) {
+        NumaNode node;
+        node.firstFrame = snapshotReadValue<int32_t>(reader);
+        node.frames = snapshotReadValue<int32_t>(reader);
+        node.nextFresh = snapshotReadValue<int32_t>(reader);
+        uint32_t freedCount = snapshotReadValue<uint32_t>(reader);
+        int expectedFirst = nodes.empty() ? 0 : nodes.back().firstFrame + nodes.back().frames;
+        if(node.firstFrame != expectedFirst || node.frames < 1 || node.nextFresh < node.firstFrame
+           || node.nextFresh > node.firstFrame + node.frames) {
+            reader.ok = false;
+        }
+        for(uint32_t j=0; j<freedCount && reader.ok; j++) {
+            int frame = snapshotReadValue<int32_t>(reader);
+            if(frame < node.firstFrame || frame >= node.nextFresh) {
+                reader.ok = false;
+            }
+            node.freed.insert(frame);
+        }
+        nodes.push_back(node);
+    }
+    if(reader.ok && nodes.back().firstFrame + nodes.back().frames != ramFrames) {
+        reader.ok = false;
+    }
+
+    count = snapshotReadValue<uint32_t>(reader);
+    for(uint32_t i=0; i<count && reader.ok; i++) {
+        int frameNumber = snapshotReadValue<int32_t>(reader);
+        loadedFrames.table[frameNumber] = snapshotReadPage(reader);
+        if(frameNumber < 0 || frameNumber >= ramFrames) {
+            reader.ok = false;
+        }
+    }
+
+    count = snapshotReadValue<uint32_t>(reader);
+    for(uint32_t i=0; i<count && reader.ok; i++) {
+        Process *process = acquireProcess();
+        process->pid = snapshotReadValue<int32_t>(reader);
+        process->code = snapshotReadValue<int32_t>(reader);
+        process->globals = snapshotReadValue<int32_t>(reader);
+        process->addressBits = snapshotReadValue<int32_t>(reader);
+        process->totalPageRemainSpace = snapshotReadValue<int64_t>(reader);
+        long long walks = snapshotReadValue<int64_t>(reader);
+        long long walkSteps = snapshotReadValue<int64_t>(reader);
+        process->accesses = snapshotReadValue<int64_t>(reader);
+        process->faults = snapshotReadValue<int64_t>(reader);
+        process->rssQuota = snapshotReadValue<int32_t>(reader);
+        process->swapQuota = snapshotReadValue<int32_t>(reader);
+        process->numaNode = snapshotReadValue<int32_t>(reader);
+        process->numaPolicy = snapshotReadValue<int32_t>(reader);
+        process->localAccesses = snapshotReadValue<int64_t>(reader);
+        process->remoteAccesses = snapshotReadValue<int64_t>(reader);
+        if(process->numaNode < 0 || process->numaNode >= (int)nodes.size()
+           || (process->numaPolicy != NUMA_FIRST_TOUCH && process->numaPolicy != NUMA_INTERLEAVE)) {
+            reader.ok = false;
+        }
+        process->currentPage = snapshotReadPage(reader);
+        process->tailSpace = snapshotReadValue<int32_t>(reader);
+        if(process->tailSpace < 0 || process->tailSpace > process->currentPage.freeSpace) {
+            reader.ok = false;
+        }
+        uint32_t pageCount = snapshotReadValue<uint32_t>(reader);
+        if(process->addressBits < 17 || process->addressBits > 48 || (1LL << process->addressBits) / pageSize > INT_MAX) {
+            reader.ok = false;
+        } else {
+            process->pages = (1LL << process->addressBits) / pageSize;
+            process->pageTable.init(process->pid, process->pages);
+            process->pageTable.walks = walks;
+            process->pageTable.walkSteps = walkSteps;
+        }
+        for(uint32_t j=0; j<pageCount && reader.ok; j++) {
+            PageUnit page = snapshotReadPage(reader);
+            if(page.pageNumber < 0 || page.pageNumber >= process->pages
+               || page.frameNumber < -1 || page.frameNumber >= ramFrames) {
+                reader.ok = false;
+                break;
+            }
+            process->pageTable[page.pageNumber] = page;
+            if(page.inMem == 1) {
+                process->swappedPages++;
+                swappedKeys.insert(make_pair(process->pid, page.pageNumber));
+            } else if(page.frameNumber != -1 && page.mapping == -1) {
+                process->residentPages++;
+            }
+        }
+        if(process->currentPage.frameNumber < -1 || process->currentPage.frameNumber >= ramFrames) {
+            reader.ok = false;
+        }
+        loadedProcesses.table[process->pid] = process;
+    }
+    //every RAM frame has to belong to a process of the snapshot
+    for(auto const& loc : loadedFrames.table) {
+        if(loadedProcesses.table.count(loc.second.pid) == 0) {
+            reader.ok = false;
+        }
+    }
+
+    count = snapshotReadValue<uint32_t>(reader);
+    for(uint32_t i=0; i<count && reader.ok; i++) {
+        string key = snapshotReadString(reader);
+        MMUObject mmu;
+        mmu.pageNumber = snapshotReadValue<int32_t>(reader);
+        mmu.frameNumber = snapshotReadValue<int32_t>(reader);
+        mmu.set = snapshotReadValue<uint8_t>(reader) != 0;
+        mmu.pid = snapshotReadValue<int32_t>(reader);
+        mmu.typeCode = snapshotReadValue<int32_t>(reader);
+        mmu.name = snapshotReadString(reader);
+        mmu.address = snapshotReadValue<int64_t>(reader);
+        mmu.size = snapshotReadValue<int64_t>(reader);
+        mmu.key = snapshotReadString(reader);
+        mmu.physicalAddr = snapshotReadValue<int32_t>(reader);
+        mmu.mapping = snapshotReadValue<int32_t>(reader);
+        mmu.pinned = snapshotReadValue<uint8_t>(reader) != 0;
+        if(key.compare(0, to_string(mmu.pid).size(), to_string(mmu.pid)) != 0) {
+            reader.ok = false; //mmuFirst finds the entries of a process by this prefix
+        }
+        //the entry has to belong to a process of the snapshot and stay inside its pages
+        auto ownerIt = loadedProcesses.table.find(mmu.pid);
+        if(ownerIt == loadedProcesses.table.end() || mmu.size < 0 || mmu.size > INT_MAX) {
+            reader.ok = false;
+        }
+        uint32_t pageCount = snapshotReadValue<uint32_t>(reader);
+        for(uint32_t j=0; j<pageCount && reader.ok; j++) {
+            int pageNumber = snapshotReadValue<int32_t>(reader);
+            int stored = snapshotReadValue<int32_t>(reader);
+            if(pageNumber < 0 || pageNumber >= ownerIt->second->pages || stored < 0 || stored > pageSize) {
+                reader.ok = false;
+            }
+            mmu.pageInfo[pageNumber] = stored;
+        }
+        loadedMMU.table[key] = mmu;
+    }
+
+    count = snapshotReadValue<uint32_t>(reader);
+    for(uint32_t i=0; i<count && reader.ok; i++) {
+        int fileId = snapshotReadValue<int32_t>(reader);
+        loadedFiles[fileId] = snapshotReadString(reader);
+    }
+    count = snapshotReadValue<uint32_t>(reader);
+    for(uint32_t i=0; i<count && reader.ok; i++) {
+        int mappingId = snapshotReadValue<int32_t>(reader);
+        FileMapping mapping;
+        mapping.fileId = snapshotReadValue<int32_t>(reader);
+        mapping.pid = snapshotReadValue<int32_t>(reader);
+        mapping.firstPage = snapshotReadValue<int32_t>(reader);
+        mapping.offset = snapshotReadValue<int64_t>(reader);
+        mapping.length = snapshotReadValue<int64_t>(reader);
+        if(loadedFiles.count(mapping.fileId) == 0 || mapping.offset % pageSize != 0
+           || loadedProcesses.table.count(mapping.pid) == 0 || mapping.firstPage < 0
+           || mapping.firstPage >= loadedProcesses.table[mapping.pid]->pages) {
+            reader.ok = false;
+        }
+        loadedMappings[mappingId] = mapping;
+    }
+    //every mapped page has to point at a mapping of the snapshot
+    for(auto const& processLoc : loadedProcesses.table) {
+        for(PageUnit *page : processLoc.second->pageTable.entries()) {
+            if(page->mapping != -1 && loadedMappings.count(page->mapping) == 0) {
+                reader.ok = false;
+            }
+        }
+    }
+
+    count = snapshotReadValue<uint32_t>(reader);
+    if(reader.ok && (uint64_t)(reader.end - reader.pos) < (uint64_t)count * (4 + pageSize)) {
+        reader.ok = false;
+    }
+    framesStart = reader.pos;
+    for(uint32_t i=0; i<count && reader.ok; i++) {
+        int frameNumber = snapshotReadValue<int32_t>(reader);
+        if(frameNumber < 0 || frameNumber >= ramFrames) {
+            reader.ok = false;
+        }
+        reader.pos += pageSize;
+    }
+    if(reader.ok) {
+        swappedCount = snapshotReadValue<uint32_t>(reader);
+        if(reader.ok && ((uint64_t)(reader.end - reader.pos) < (uint64_t)swappedCount * (8 + pageSize)
+                         || swappedCount > SWAP_SIZE / pageSize)) {
+            reader.ok = false;
+        }
+    }
+    //every swapped page has to be one the page tables say is swapped out, and each of
+    //those needs its data
+    for(uint32_t i=0; i<swappedCount && reader.ok; i++) {
+        int pid = snapshotReadValue<int32_t>(reader);
+        int pageNumber = snapshotReadValue<int32_t>(reader);
+        if(swappedKeys.erase(make_pair(pid, pageNumber)) == 0) {
+            reader.ok = false;
+        }
+        reader.pos += pageSize;
+    }
+    if(!swappedKeys.empty()) {
+        reader.ok = false;
+    }
+    if(!reader.ok) {
+        cout << fileName << " is truncated or corrupt" << endl;
+        for(auto const& processLoc : loadedProcesses.table) {
+            releaseProcess(processLoc.second);
+        }
+        goto unmap;
+    }
+
+    //everything parsed, replace the running state
+    swapDiscardAll();
+    for(auto const& processLoc : processTable.table) {
+        releaseProcess(processLoc.second);
+    }
+    if(commandInput.pageSize != pageSize) {
+        commandInput.pageSize = pageSize;
+        reclaimSetWatermarks(); //they count frames, which changed size
+    }
+    mainInfo.currentPID = currentPID;
+    accessInfo.clock = accessClock;
+    numaInfo.nodes.swap(nodes);
+    numaInfo.nextNode %= numaInfo.nodes.size();
+    frameTable.table.swap(loadedFrames.table);
+    processTable.table.swap(loadedProcesses.table);
+    mmuTable.table.swap(loadedMMU.table);
+    //the page cache starts out empty, mapped pages are read from their files again
+    pageCacheReset();
+    adviseInfo.coldPages.clear();
+    for(auto const& loc : loadedFiles) {
+        MappedFile &file = pageCache.files[loc.first];
+        file.path = loc.second;
+        file.fd = open(file.path.c_str(), O_RDONLY);
+        struct stat fileInfo;
+        if(file.fd >= 0 && fstat(file.fd, &fileInfo) == 0) {
+            file.device = fileInfo.st_dev;
+            file.inode = fileInfo.st_ino;
+            pageCache.fileIds[make_pair(file.device, file.inode)] = loc.first;
+        } else {
+            cout << "Could not open " << file.path << " again, its mapped pages read as zeros" << endl;
+            if(file.fd >= 0) {
+                close(file.fd);
+            }
+            file.fd = -1;
+        }
+        pageCache.nextFileId = max(pageCache.nextFileId, loc.first + 1);
+    }
+    for(auto const& loc : loadedMappings) {
+        pageCache.mappings[loc.first] = loc.second;
+        pageCache.files[loc.second.fileId].mappings++;
+        pageCache.nextMapping = max(pageCache.nextMapping, loc.first + 1);
+    }
+    for(auto const& processLoc : processTable.table) {
+        for(PageUnit *page : processLoc.second->pageTable.entries()) {
+            if(page->mapping != -1) {
+                page->frameNumber = -1;
+                syncCurrentPage(processLoc.second, *page);
+            }
+        }
+    }
+    memset(mainInfo.mem, 0, 67108864);
+    reader.pos = framesStart;
+    for(uint32_t i=0; i<count; i++) {
+        int frameNumber = snapshotReadValue<int32_t>(reader);
+        memcpy(mainInfo.mem + (long)frameNumber * pageSize, reader.pos, pageSize);
+        reader.pos += pageSize;
+    }
+    reader.pos += 4;
+    //swapped pages are laid out again from the start of a fresh swap file
+    swapSpace.swapMap.clear();
+    swapSpace.freeSlots.clear();
+    swapSpace.slotEnd = 0;
+    swapSetFileSlots(0, true);
+    zswapPool.entries.clear();
+    zswapPool.lru.clear();
+    zswapPool.used = 0;
+    for(uint32_t i=0; i<swappedCount; i++) {
+        int pid = snapshotReadValue<int32_t>(reader);
+        int pageNumber = snapshotReadValue<int32_t>(reader);
+        if(!swapOutPage(pid, pageNumber, reader.pos)) {
+            //the page tables would point at data that is not there, drop what was loaded
+            cout << "Could not write the swapped pages of " << fileName << " back to swap, the loaded processes are discarded" << endl;
+            while(!processTable.table.empty()) {
+                terminatePID(processTable.table.begin()->first);
+            }
+            goto unmap;
+        }
+        reader.pos += pageSize;
+    }
+    swapInfo.clockHand = 0;
+    cout << "Loaded " << processTable.table.size() << " processes and " << count + swappedCount << " pages from " << fileName
+         << " (page size " << pageSize << " bytes)" << endl;
+
+    unmap:
+    munmap(mapped, info.st_size);
+}
+
+template<typename T> void snapshotWriteValue(FILE *file, T value) {
+    fwrite(&value, sizeof(T), 1, file);
+}
+
+void snapshotWriteString(FILE *file, const string& str) {
+    snapshotWriteValue<uint32_t>(file, str.size());
+    fwrite(str.data(), 1, str.size(), file);
+}
+
+void snapshotWritePage(FILE *file, const PageUnit& page) {
+    snapshotWriteValue<int32_t>(file, page.pid);
+    snapshotWriteValue<int32_t>(file, page.pageSize);
+    snapshotWriteValue<int32_t>(file, page.freeSpace);
+    snapshotWriteValue<int32_t>(file, page.pageNumber);
+    snapshotWriteValue<int32_t>(file, page.frameNumber);
+    snapshotWriteValue<int32_t>(file, page.inMem);
+    snapshotWriteValue<uint8_t>(file, page.referenced);
+    snapshotWriteValue<uint8_t>(file, page.dirty);
+    snapshotWriteValue<int64_t>(file, page.lastAccess);
+    snapshotWriteValue<int32_t>(file, page.mapping);
+    snapshotWriteValue<int32_t>(file, page.pinned);
+}
+
+//reads past the end leave the reader marked as failed and return 0
+template<typename T> T snapshotReadValue(SnapshotReader &reader) {
+    T value = 0;
+    if(!reader.ok || reader.end - reader.pos < (long)sizeof(T)) {
+        reader.ok = false;
+        return value;
+    }
+    memcpy(&value, reader.pos, sizeof(T));
+    reader.pos += sizeof(T);
+    return value;
+}
+
+string snapshotReadString(SnapshotReader &reader) {
+    uint32_t length = snapshotReadValue<uint32_t>(reader);
+    if(!reader.ok || (uint64_t)(reader.end - reader.pos) < length) {
+        reader.ok = false;
+        return "";
+    }
+    string str((const char*) reader.pos, length);
+    reader.pos += length;
+    return str;
+}
+
+PageUnit snapshotReadPage(SnapshotReader &reader) {
+    PageUnit page;
+    page.pid = snapshotReadValue<int32_t>(reader);
+    page.pageSize = snapshotReadValue<int32_t>(reader);
+    page.freeSpace = snapshotReadValue<int32_t>(reader);
+    page.pageNumber = snapshotReadValue<int32_t>(reader);
+    page.frameNumber = snapshotReadValue<int32_t>(reader);
+    page.inMem = snapshotReadValue<int32_t>(reader);
+    page.referenced = snapshotReadValue<uint8_t>(reader);
+    page.dirty = snapshotReadValue<uint8_t>(reader);
+    page.lastAccess = snapshotReadValue<int64_t>(reader);
+    page.mapping = snapshotReadValue<int32_t>(reader);
+    page.pinned = snapshotReadValue<int32_t>(reader);
+    return page;
+}
+
+void swapStart() {
+    swapInfo.fd = open("memfile.txt", O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(swapInfo.fd < 0) {
+        cout << "Could not open memfile.txt for swapping" << endl;
+        exit(6);
+    }
+    swapInfo.worker = thread(swapWorker);
+}
+
+//flushes every queued write-back and stops the I/O thread, runs at exit
+void swapShutdown() {
+    if(!swapInfo.worker.joinable()) {
+        return;
+    }
+    {
+        lock_guard<mutex> guard(swapInfo.lock);
+        swapInfo.stop = true;
+    }
+    swapInfo.wake.notify_one();
+    swapInfo.worker.join();
+    close(swapInfo.fd);
+    swapInfo.fd = -1;
+}
+
+void swapWorker() {
+    unique_lock<mutex> lk(swapInfo.lock);
+    while(true) {
+        swapInfo.wake.wait(lk, [] {
+            return swapInfo.stop || swapInfo.shrink || !swapInfo.pending.empty() || !swapInfo.prefetchQueue.empty();
+        });
+        if(!swapInfo.pending.empty()) {
+            //take the whole queue as one batch, the foreground can keep queueing meanwhile
+            swapInfo.writing.swap(swapInfo.pending);
+            lk.unlock();
+            swapWriteBatch(swapInfo.writing);
+            lk.lock();
+            swapInfo.writing.clear();
+            swapInfo.drained.notify_all();
+            continue;
+        }
+        if(swapInfo.shrink) {
+            //every queued write is below fileSlots, so nothing live is cut off
+            ftruncate(swapInfo.fd, (off_t)swapInfo.fileSlots * commandInput.pageSize);
+            swapInfo.shrink = false;
+            continue;
+        }
+        if(!swapInfo.prefetchQueue.empty()) {
+            vector<int> slots;
+            for(size_t i=0; i<swapInfo.prefetchQueue.size(); i++) {
+                int slot = swapInfo.prefetchQueue[i];
+                if(swapInfo.pending.count(slot) == 0 && swapInfo.prefetched.count(slot) == 0) {
+                    slots.push_back(slot);
+                }
+            }
+            swapInfo.prefetchQueue.clear();
+            lk.unlock();
+            vector<vector<uint8_t>> pages(slots.size(), vector<uint8_t>(commandInput.pageSize, 0));
+            for(size_t i=0; i<slots.size(); i++) {
+                pread(swapInfo.fd, pages[i].data(), commandInput.pageSize, (off_t)slots[i] * commandInput.pageSize);
+            }
+            lk.lock();
+            for(size_t i=0; i<slots.size(); i++) {
+                //a slot that was rewritten while we were reading is stale
+                if(swapInfo.pending.count(slots[i]) == 0 && swapInfo.prefetched.size() < SWAP_PREFETCH_LIMIT) {
+                    swapInfo.prefetched[slots[i]].swap(pages[i]);
+                    swapInfo.prefetchReads++;
+                }
+            }
+            continue;
+        }
+        if(swapInfo.stop) {
+            break;
+        }
+    }
+}
+
+//writes a batch of evicted pages, merging runs of neighbouring slots into one pwrite
+void swapWriteBatch(map<int, vector<uint8_t>>& batch) {
+    int pageSize = commandInput.pageSize;
+    long long calls = 0;
+    vector<uint8_t> run;
+    auto it = batch.begin();
+    while(it != batch.end()) {
+        int firstSlot = it->first;
+        int nextSlot = firstSlot;
+        run.clear();
+        while(it != batch.end() && it->first == nextSlot) {
+            run.insert(run.end(), it->second.begin(), it->second.end());
+            nextSlot++;
+            ++it;
+        }
+        if(pwrite(swapInfo.fd, run.data(), run.size(), (off_t)firstSlot * pageSize) != (ssize_t)run.size()) {
+            cerr << "swap write to memfile.txt failed" << endl;
+        }
+        calls++;
+    }
+    lock_guard<mutex> guard(swapInfo.lock);
+    swapInfo.writeCalls += calls;
+}
+
+//queues a page for write-back, only waits when the queue is full
+void swapWriteSlot(int slot, const uint8_t *data) {
+    unique_lock<mutex> lk(swapInfo.lock);
+    if(swapInfo.pending.size() >= SWAP_QUEUE_LIMIT && swapInfo.pending.count(slot) == 0) {
+        swapInfo.stalls++;
+        swapInfo.drained.wait(lk, [] { return swapInfo.pending.size() < SWAP_QUEUE_LIMIT; });
+    }
+    swapInfo.pending[slot].assign(data, data + commandInput.pageSize);
+    swapInfo.prefetched.erase(slot);
+    swapInfo.pagesOut++;
+    swapInfo.wake.notify_one();
+}
+
+//reads a slot, preferring write-backs still queued and pages already read ahead
+void swapReadSlot(int slot, uint8_t *data) {
+    {
+        lock_guard<mutex> guard(swapInfo.lock);
+        auto it = swapInfo.pending.find(slot);
+        if(it != swapInfo.pending.end()) {
+            memcpy(data, it->second.data(), commandInput.pageSize);
+            return;
+        }
+        it = swapInfo.writing.find(slot);
+        if(it != swapInfo.writing.end()) {
+            memcpy(data, it->second.data(), commandInput.pageSize);
+            return;
+        }
+        it = swapInfo.prefetched.find(slot);
+        if(it != swapInfo.prefetched.end()) {
+            memcpy(data, it->second.data(), commandInput.pageSize);
+            swapInfo.prefetched.erase(it);
+            swapInfo.prefetchHits++;
+            return;
+        }
+    }
+    ssize_t got = pread(swapInfo.fd, data, commandInput.pageSize, (off_t)slot * commandInput.pageSize);
+    if(got < commandInput.pageSize) {
+        memset(data + max(got, (ssize_t)0), 0, commandInput.pageSize - max(got, (ssize_t)0));
+    }
+}
+
+//the slot no longer holds a live page, drop anything queued or cached for it
+void swapDiscardSlot(int slot) {
+    lock_guard<mutex> guard(swapInfo.lock);
+    swapInfo.pending.erase(slot);
+    swapInfo.prefetched.erase(slot);
+}
+
+//records how many slots memfile.txt holds, the I/O thread trims the file when it shrinks
+void swapSetFileSlots(int slots, bool shrink) {
+    lock_guard<mutex> guard(swapInfo.lock);
+    swapInfo.fileSlots = slots;
+    if(shrink) {
+        swapInfo.shrink = true;
+        swapInfo.wake.notify_one();
+    }
+}
+
+//hands out a swap slot for (pid, pageNumber), preferring the slot right after the
+//previous page of the same process so a process' swapped pages stay sequential,
+//then the lowest released slot, then a new slot at the end of the file
+int allocateSwapSlot(int pid, int pageNumber) {
+    int slot = -1;
+    int maxSlots = SWAP_SIZE / commandInput.pageSize;
+    auto prev = swapSpace.swapMap.find(make_pair(pid, pageNumber - 1));
+    bool follows = prev != swapSpace.swapMap.end();
+    if(follows && swapSpace.freeSlots.erase(prev->second + 1) == 1) {
+        slot = prev->second + 1;
+    } else if(follows && prev->second + 1 == swapSpace.slotEnd && swapSpace.slotEnd < maxSlots) {
+        slot = swapSpace.slotEnd++;
+    } else if(!swapSpace.freeSlots.empty()) {
+        slot = *swapSpace.freeSlots.begin();
+        swapSpace.freeSlots.erase(swapSpace.freeSlots.begin());
+    } else if(swapSpace.slotEnd < maxSlots) {
+        slot = swapSpace.slotEnd++;
+    } else {
+        return -1;
+    }
+    if(slot == swapSpace.slotEnd - 1) {
+        swapSetFileSlots(swapSpace.slotEnd, false);
+    }
+    swapSpace.swapMap[make_pair(pid, pageNumber)] = slot;
+    return slot;
+}
+
+//frees the slot of a swapped out page and trims released slots off the end of the file
+void releaseSwapSlot(int pid, int pageNumber) {
+    auto it = swapSpace.swapMap.find(make_pair(pid, pageNumber));
+    if(it == swapSpace.swapMap.end()) {
+        return;
+    }
+    int slot = it->second;
+    swapSpace.swapMap.erase(it);
+    swapDiscardSlot(slot);
+    swapSpace.freeSlots.insert(slot);
+    if(slot == swapSpace.slotEnd - 1) {
+        while(!swapSpace.freeSlots.empty() && *swapSpace.freeSlots.rbegin() == swapSpace.slotEnd - 1) {
+            swapSpace.freeSlots.erase(prev(swapSpace.freeSlots.end()));
+            swapSpace.slotEnd--;
+        }
+        swapSetFileSlots(swapSpace.slotEnd, true);
+    }
+}
+
+void swapDiscardAll() {
+    unique_lock<mutex> lk(swapInfo.lock);
+    swapInfo.pending.clear();
+    swapInfo.prefetched.clear();
+    swapInfo.prefetchQueue.clear();
+    swapInfo.drained.wait(lk, [] { return swapInfo.writing.empty(); });
+}
+
+//brings a swapped out page back into RAM, evicting another page if RAM is full
+void swapIn(Process *process, PageUnit& page) {
+    int pageSize = commandInput.pageSize;
+    int frame = allocateFrame(page.pid, page.pageNumber, false);
+    if(frame == -1) {
+        return;
+    }
+    swapReadPage(page.pid, page.pageNumber, mainInfo.mem + (long)frame * pageSize);
+    releaseSwappedPage(page.pid, page.pageNumber);
+    page.frameNumber = frame;
+    page.inMem = 0;
+    page.dirty = 0;
+    frameTable.table[frame] = page;
+    syncCurrentPage(process, page);
+    swapInfo.pagesIn++;
+    process->faults++;
+    process->swappedPages--;
+    swapPrefetchNeighbours(process, page.pageNumber);
+}
+
+//asks the I/O thread to read ahead the swapped out pages next to pageNumber
+void swapPrefetchNeighbours(Process *process, int pageNumber) {
+    vector<int> slots;
+    for(int i=1; i<=SWAP_PREFETCH_PAGES; i++) {
+        auto it = swapSpace.swapMap.find(make_pair(process->pid, pageNumber + i));
+        if(it != swapSpace.swapMap.end()) {
+            slots.push_back(it->second);
+        }
+        it = swapSpace.swapMap.find(make_pair(process->pid, pageNumber - i));
+        if(it != swapSpace.swapMap.end()) {
+            slots.push_back(it->second);
+        }
+    }
+    if(slots.empty()) {
+        return;
+    }
+    lock_guard<mutex> guard(swapInfo.lock);
+    swapInfo.prefetchQueue.insert(swapInfo.prefetchQueue.end(), slots.begin(), slots.end());
+    swapInfo.wake.notify_one();
+}
+
+//clock replacement: walks RAM frames round robin from the clock hand, giving pages
+//that were referenced since the last pass a second chance, and returns the first
+//unreferenced frame holding a page other than (pid, pageNumber), -1 if there is none.
+//With ownerPid other than -1 only pages of that process are considered, and pages of
+//processes that reached their swap quota are never chosen.
+int chooseVictimFrame(int pid, int pageNumber, int ownerPid) {
+    int ramFrames = 67108864 / commandInput.pageSize;
+    if(frameTable.table.empty()) {
+        return -1;
+    }
+    //pages advised cold go first, entries of pages that left RAM are dropped on the way
+    for(auto coldIt = adviseInfo.coldPages.begin(); coldIt != adviseInfo.coldPages.end(); ) {
+        auto processIt = processTable.table.find(coldIt->first);
+        if(processIt == processTable.table.end() || coldIt->second >= processIt->second->pages) {
+            coldIt = adviseInfo.coldPages.erase(coldIt);
+            continue;
+        }
+        Process *owner = processIt->second;
+        PageUnit &page = owner->pageTable[coldIt->second];
+        if(page.frameNumber == -1 || page.inMem == 1 || page.mapping != -1) {
+            coldIt = adviseInfo.coldPages.erase(coldIt);
+        } else if((owner->pid == pid && page.pageNumber == pageNumber) || (ownerPid != -1 && owner->pid != ownerPid)
+                  || page.pinned > 0 || (owner->swapQuota > 0 && owner->swappedPages >= owner->swapQuota)) {
+            ++coldIt;
+        } else {
+            adviseInfo.coldPages.erase(coldIt);
+            return page.frameNumber;
+        }
+    }
+    auto it = frameTable.table.lower_bound(swapInfo.clockHand);
+    for(size_t scanned = 0; scanned <= 2 * frameTable.table.size(); scanned++, ++it) {
+        if(it == frameTable.table.end() || it->first >= ramFrames) {
+            it = frameTable.table.begin();
+            if(it->first >= ramFrames) {
+                return -1;
+            }
+        }
+        const PageUnit &entry = it->second;
+        if((entry.pid == pid && entry.pageNumber == pageNumber) || (ownerPid != -1 && entry.pid != ownerPid)) {
+            continue;
+        }
+        auto processIt = processTable.table.find(entry.pid);
+        if(processIt == processTable.table.end()) {
+            continue;
+        }
+        Process *owner = processIt->second;
+        if(owner->swapQuota > 0 && owner->swappedPages >= owner->swapQuota) {
+            continue;
+        }
+        if(entry.pageNumber < 0 || entry.pageNumber >= owner->pages) {
+            continue;
+        }
+        PageUnit &page = owner->pageTable[entry.pageNumber];
+        if(page.frameNumber != it->first || page.inMem == 1 || page.pinned > 0) {
+            continue;
+        }
+        if(page.referenced == 1) {
+            page.referenced = 0;
+            syncCurrentPage(owner, page);
+            continue;
+        }
+        swapInfo.clockHand = it->first + 1;
+        return it->first;
+    }
+    return -1;
+}
+
+//currentPage is a copy of a pageTable entry that pageHandler writes back, keep
+//everything but its freeSpace in step when the pageTable entry changes
+void syncCurrentPage(Process *process, const PageUnit& page) {
+    if(process->currentPage.pageNumber == page.pageNumber) {
+        process->currentPage.frameNumber = page.frameNumber;
+        process->currentPage.inMem = page.inMem;
+        process->currentPage.referenced = page.referenced;
+        process->currentPage.dirty = page.dirty;
+        process->currentPage.lastAccess = page.lastAccess;
+        process->currentPage.mapping = page.mapping;
+        process->currentPage.pinned = page.pinned;
+    }
+}
+
+//translates a page of the process to its location in mainInfo.mem, faulting it in if
+//swapped or mapped from a file and giving it a zeroed frame if it has none yet, NULL
+//if no frame can be found
+uint8_t *pageFrameAddress(Process *process, int pageNumber) {
+    PageUnit &page = process->pageTable.walk(pageNumber);
+    if(page.inMem == 1) {
+        swapIn(process, page);
+    } else if(page.frameNumber == -1 && page.mapping != -1) {
+        filePageIn(process, page);
+    } else if(page.frameNumber == -1) {
+        int frame = allocateFrame(process->pid, pageNumber, false);
+        if(frame != -1) {
+            memset(mainInfo.mem + (long)frame * commandInput.pageSize, 0, commandInput.pageSize);
+            page.frameNumber = frame;
+            frameTable.table[frame] = page;
+            syncCurrentPage(process, page);
+        }
+    }
+    if(page.inMem == 1 || page.frameNumber == -1) {
+        return NULL;
+    }
+    return mainInfo.mem + (long)page.frameNumber * commandInput.pageSize;
+}
+
+//the pageInfo of a variable lists the pages it spans in order, the first piece
+//starts where physicalAddr points inside its page and every later piece at offset 0
+void copyToVariable(const MMUObject& mmu, int offset, const uint8_t *src, int length) {
+    Process *process = processTable.table[mmu.pid];
+    int pageOffset = mmu.physicalAddr % commandInput.pageSize;
+    for(auto const& loc : mmu.pageInfo) {
+        if(length == 0) {
+            break;
+        }
+        if(offset < loc.second) {
+            int amount = min(loc.second - offset, length);
+            uint8_t *frameAddr = pageFrameAddress(process, loc.first);
+            if(frameAddr != NULL && process->pageTable[loc.first].mapping != -1) {
+                frameAddr = privatePageAddress(process, loc.first);
+            }
+            if(frameAddr == NULL) {
+                cout << "Out of memory: page " << loc.first << " of process " << mmu.pid << " is not in RAM" << endl;
+                return;
+            }
+            memcpy(frameAddr + pageOffset + offset, src, amount);
+            touchPage(process, loc.first, true);
+            src += amount;
+            length -= amount;
+            offset = 0;
+        } else {
+            offset -= loc.second;
+        }
+        pageOffset = 0;
+    }
+}
+
+void copyFromVariable(const MMUObject& mmu, int offset, uint8_t *dst, int length) {
+    Process *process = processTable.table[mmu.pid];
+    int pageOffset = mmu.physicalAddr % commandInput.pageSize;
+    for(auto const& loc : mmu.pageInfo) {
+        if(length == 0) {
+            break;
+        }
+        if(offset < loc.second) {
+            int amount = min(loc.second - offset, length);
+            uint8_t *frameAddr = pageFrameAddress(process, loc.first);
+            if(frameAddr == NULL) {
+                cout << "Out of memory: page " << loc.first << " of process " << mmu.pid << " is not in RAM" << endl;
+                memset(dst, 0, length);
+                return;
+            }
+            memcpy(dst, frameAddr + pageOffset + offset, amount);
+            touchPage(process, loc.first, false);
+            dst += amount;
+            length -= amount;
+            offset = 0;
+        } else {
+            offset -= loc.second;
+        }
+        pageOffset = 0;
+    }
+}
+
+void printSwap() {
+    lock_guard<mutex> guard(swapInfo.lock);
+    printf("|%24s | %12s \n", "Swap Counter", "Value");
+    printf("+-------------------------+--------------\n");
+    printf("| %23s | %12lld \n", "pages written out", swapInfo.pagesOut);
+    printf("| %23s | %12lld \n", "write calls", swapInfo.writeCalls);
+    printf("| %23s | %12lld \n", "pages swapped in", swapInfo.pagesIn);
+    printf("| %23s | %12lld \n", "pages prefetched", swapInfo.prefetchReads);
+    printf("| %23s | %12lld \n", "prefetch hits", swapInfo.prefetchHits);
+    printf("| %23s | %12lld \n", "eviction stalls", swapInfo.stalls);
+    printf("| %23s | %12d \n", "pages queued", (int)(swapInfo.pending.size() + swapInfo.writing.size()));
+    printf("| %23s | %12d \n", "pages in swap", (int)swapSpace.swapMap.size());
+    printf("| %23s | %12lld \n", "swap file bytes", (long long)swapSpace.slotEnd * commandInput.pageSize);
+    long long original = (long long)zswapPool.entries.size() * commandInput.pageSize;
+    printf("| %23s | %12d \n", "pages in zswap pool", (int)zswapPool.entries.size());
+    printf("| %23s | %12lld \n", "zswap pool bytes", zswapPool.used);
+    printf("| %23s | %12lld \n", "zswap budget", zswapPool.budget);
+    printf("| %23s | %12.2f \n", "zswap compression ratio", zswapPool.used == 0 ? 0.0 : (double)original / zswapPool.used);
+    printf("| %23s | %12lld \n", "zswap pages stored", zswapPool.stored);
+    printf("| %23s | %12lld \n", "zswap pages loaded", zswapPool.loads);
+    printf("| %23s | %12lld \n", "zswap pages rejected", zswapPool.rejected);
+    printf("| %23s | %12lld \n", "zswap pages written back", zswapPool.writtenBack);
+}
+
+//a page leaving RAM goes to the compressed pool when it compresses well and fits,
+//otherwise to a slot in memfile.txt, false when neither has room
+bool swapOutPage(int pid, int pageNumber, const uint8_t *data) {
+    if(zswapStore(pid, pageNumber, data)) {
+        return true;
+    }
+    int slot = allocateSwapSlot(pid, pageNumber);
+    if(slot == -1) {
+        return false;
+    }
+    swapWriteSlot(slot, data);
+    return true;
+}
+
+//copies a swapped out page into data, wherever it lives, without releasing it
+void swapReadPage(int pid, int pageNumber, uint8_t *data) {
+    if(zswapLoad(pid, pageNumber, data)) {
+        return;
+    }
+    auto it = swapSpace.swapMap.find(make_pair(pid, pageNumber));
+    if(it != swapSpace.swapMap.end()) {
+        swapReadSlot(it->second, data);
+    } else {
+        memset(data, 0, commandInput.pageSize);
+    }
+}
+
+void releaseSwappedPage(int pid, int pageNumber) {
+    auto it = zswapPool.entries.find(make_pair(pid, pageNumber));
+    if(it != zswapPool.entries.end()) {
+        zswapPool.used -= it->second.data.size();
+        zswapPool.lru.erase(it->second.sequence);
+        zswapPool.entries.erase(it);
+        return;
+    }
+    releaseSwapSlot(pid, pageNumber);
+}
+
+bool zswapStore(int pid, int pageNumber, const uint8_t *data) {
+    if(zswapPool.budget == 0) {
+        return false;
+    }
+    ZswapEntry entry;
+    zswapCompress(data, commandInput.pageSize, entry.data);
+    if(entry.data.size() * 100 > (size_t)commandInput.pageSize * ZSWAP_ACCEPT_PERCENT
+       || (long long)entry.data.size() > zswapPool.budget) {
+        zswapPool.rejected++;
+        return false;
+    }
+    //make room by pushing the oldest pages on to disk
+    while(zswapPool.used + (long long)entry.data.size() > zswapPool.budget) {
+        if(!zswapWriteBack()) {
+            return false;
+        }
+    }
+    entry.data.shrink_to_fit();
+    entry.sequence = zswapPool.sequence++;
+    zswapPool.used += entry.data.size();
+    zswapPool.lru[entry.sequence] = make_pair(pid, pageNumber);
+    zswapPool.entries[make_pair(pid, pageNumber)].data.swap(entry.data);
+    zswapPool.entries[make_pair(pid, pageNumber)].sequence = entry.sequence;
+    zswapPool.stored++;
+    return true;
+}
+
+bool zswapLoad(int pid, int pageNumber, uint8_t *data) {
+    auto it = zswapPool.entries.find(make_pair(pid, pageNumber));
+    if(it == zswapPool.entries.end()) {
+        return false;
+    }
+    zswapDecompress(it->second.data, data, commandInput.pageSize);
+    zswapPool.loads++;
+    return true;
+}
+
+//moves the oldest page of the pool to a swap slot, false if the pool is empty or swap is full
+bool zswapWriteBack() {
+    if(zswapPool.lru.empty()) {
+        return false;
+    }
+    pair<int, int> key = zswapPool.lru.begin()->second;
+    int slot = allocateSwapSlot(key.first, key.second);
+    if(slot == -1) {
+        return false;
+    }
+    vector<uint8_t> buffer(commandInput.pageSize);
+    ZswapEntry &entry = zswapPool.entries[key];
+    zswapDecompress(entry.data, buffer.data(), commandInput.pageSize);
+    swapWriteSlot(slot, buffer.data());
+    zswapPool.used -= entry.data.size();
+    zswapPool.lru.erase(zswapPool.lru.begin());
+    zswapPool.entries.erase(key);
+    zswapPool.writtenBack++;
+    return true;
+}
+
+//LZ4 style block compression: every sequence is a token (literal count in the high
+//nibble, match length - 4 in the low nibble, 15 meaning more length bytes follow),
+//the literals, then a 2 byte little endian offset back to the match. The last
+//sequence only carries literals.
+void zswapCompress(const uint8_t *src, int length, vector<uint8_t>& dst) {
+    const int hashBits = 12;
+    vector<int> table(1 << hashBits, -1);
+    dst.clear();
+    dst.reserve(length / 4 + 16);
+    int anchor = 0;
+    int i = 0;
+    while(i + 4 <= length) {
+        uint32_t sequence;
+        memcpy(&sequence, src + i, 4);
+        uint32_t hash = (sequence * 2654435761u) >> (32 - hashBits);
+        int candidate = table[hash];
+        table[hash] = i;
+        uint32_t candidateSequence = 0;
+        if(candidate >= 0) {
+            memcpy(&candidateSequence, src + candidate, 4);
+        }
+        if(candidate < 0 || i - candidate > 65535 || candidateSequence != sequence) {
+            i++;
+            continue;
+        }
+        int matchLength = 4;
+        while(i + matchLength < length && src[candidate + matchLength] == src[i + matchLength]) {
+            matchLength++;
+        }
+        int literals = i - anchor;
+        int extraMatch = matchLength - 4;
+        dst.push_back((uint8_t)((min(literals, 15) << 4) | min(extraMatch, 15)));
+        if(literals >= 15) {
+            int rest = literals - 15;
+            for(; rest >= 255; rest -= 255) {
+                dst.push_back(255);
+            }
+            dst.push_back((uint8_t)rest);
+        }
+        dst.insert(dst.end(), src + anchor, src + i);
+        dst.push_back((uint8_t)((i - candidate) & 0xff));
+        dst.push_back((uint8_t)((i - candidate) >> 8));
+        if(extraMatch >= 15) {
+            int rest = extraMatch - 15;
+            for(; rest >= 255; rest -= 255) {
+                dst.push_back(255);
+            }
+            dst.push_back((uint8_t)rest);
+        }
+        i += matchLength;
+        anchor = i;
+    }
+    int literals = length - anchor;
+    dst.push_back((uint8_t)(min(literals, 15) << 4));
+    if(literals >= 15) {
+        int rest = literals - 15;
+        for(; rest >= 255; rest -= 255) {
+            dst.push_back(255);
+        }
+        dst.push_back((uint8_t)rest);
+    }
+    dst.insert(dst.end(), src + anchor, src + length);
+}
+
+//inverse of zswapCompress, false if the data does not decode to exactly length bytes
+bool zswapDecompress(const vector<uint8_t>& src, uint8_t *dst, int length) {
+    const uint8_t *in = src.data();
+    const uint8_t *inEnd = in + src.size();
+    int out = 0;
+    while(in < inEnd) {
+        int token = *in++;
+        int literals = token >> 4;
+        if(literals == 15) {
+            while(in < inEnd) {
+                int more = *in++;
+                literals += more;
+                if(more != 255) {
+                    break;
+                }
+            }
+        }
+        if(literals > inEnd - in || literals > length - out) {
+            return false;
+        }
+        memcpy(dst + out, in, literals);
+        in += literals;
+        out += literals;
+        if(in == inEnd) {
+            break;
+        }
+        if(inEnd - in < 2) {
+            return false;
+        }
+        int offset = in[0] | (in[1] << 8);
+        in += 2;
+        int matchLength = (token & 15) + 4;
+        if((token & 15) == 15) {
+            while(in < inEnd) {
+                int more = *in++;
+                matchLength += more;
+                if(more != 255) {
+                    break;
+                }
+            }
+        }
+        if(offset == 0 || offset > out || matchLength > length - out) {
+            return false;
+        }
+        //byte by byte, the match may overlap the bytes it produces
+        for(int j=0; j<matchLength; j++) {
+            dst[out + j] = dst[out - offset + j];
+        }
+        out += matchLength;
+    }
+    return out == length;
+}
+
+void setConfig(string name, string value) {
+    if(name == "numa_policy") {
+        if(numaPolicyCode(value) == -1) {
+            cout << "numa_policy must be firsttouch or interleave" << endl;
+            return;
+        }
+        numaInfo.policy = numaPolicyCode(value);
+        return;
+    }
+    if(!isNumber(value)) {
+        cout << "The value of " << name << " must be a non negative integer" << endl;
+        return;
+    }
+    if(name == "zswap_budget") {
+        if(value.size() > 18) {
+            cout << "The value of " << name << " must be a non negative integer" << endl;
+            return;
+        }
+        zswapPool.budget = stoll(value);
+        //a smaller budget pushes the oldest pages out to disk right away
+        while(zswapPool.used > zswapPool.budget && zswapWriteBack()) {
+        }
+    } else if(name == "reclaim_low" || name == "reclaim_high") {
+        if(value.size() > 9) {
+            cout << "The value of " << name << " must be a non negative integer" << endl;
+            return;
+        }
+        int frames = stoi(value);
+        int low = name == "reclaim_low" ? frames : reclaimInfo.lowWatermark;
+        int high = name == "reclaim_high" ? frames : reclaimInfo.highWatermark;
+        if(low > high || high > 67108864 / commandInput.pageSize) {
+            cout << "reclaim_low must not exceed reclaim_high, which must not exceed the number of RAM frames" << endl;
+            return;
+        }
+        reclaimInfo.lowWatermark = low;
+        reclaimInfo.highWatermark = high;
+        reclaimInfo.wake.notify_one();
+    } else if(name == "ws_window") {
+        if(value.size() > 18) {
+            cout << "The value of " << name << " must be a non negative integer" << endl;
+            return;
+        }
+        if(stoll(value) == 0) {
+            cout << "ws_window must be at least 1" << endl;
+            return;
+        }
+        accessInfo.window = stoll(value);
+    } else if(name == "address_bits") {
+        if(value.size() > 2 || stoi(value) < 17 || stoi(value) > maxAddressBits()) {
+            cout << "address_bits must be from 17 to " << maxAddressBits() << " with this page size" << endl;
+            return;
+        }
+        commandInput.addressBits = stoi(value);
+    } else if(name == "numa_nodes") {
+        if(value.size() > 1 || stoi(value) < 1 || stoi(value) > NUMA_MAX_NODES) {
+            cout << "numa_nodes must be from 1 to " << NUMA_MAX_NODES << endl;
+            return;
+        }
+        if(!frameTable.table.empty() || !pageCache.entries.empty()) {
+            cout << "NUMA nodes can only be changed while no frame is in use" << endl;
+            return;
+        }
+        numaConfigure(stoi(value));
+        //processes that are already there stay on a node that still exists
+        for(auto const& processLoc : processTable.table) {
+            processLoc.second->numaNode %= numaInfo.nodes.size();
+        }
+        numaInfo.nextNode %= numaInfo.nodes.size();
+    } else if(name == "compact_threshold") {
+        if(value.size() > 3 || stoi(value) > 100) {
+            cout << "compact_threshold is a percentage and must not exceed 100" << endl;
+            return;
+        }
+        compactInfo.threshold = stoi(value);
+    } else {
+        cout << name << " is not a setting" << endl;
+    }
+}
+
+void printConfig() {
+    printf("|%24s | %12s \n", "Setting", "Value");
+    printf("+-------------------------+--------------\n");
+    printf("| %23s | %12lld \n", "zswap_budget", zswapPool.budget);
+    printf("| %23s | %12lld \n", "ws_window", accessInfo.window);
+    printf("| %23s | %12d \n", "reclaim_low", reclaimInfo.lowWatermark);
+    printf("| %23s | %12d \n", "reclaim_high", reclaimInfo.highWatermark);
+    printf("| %23s | %12d \n", "address_bits", commandInput.addressBits);
+    printf("| %23s | %12zu \n", "numa_nodes", numaInfo.nodes.size());
+    printf("| %23s | %12s \n", "numa_policy", numaInfo.policy == NUMA_INTERLEAVE ? "interleave" : "firsttouch");
+    printf("| %23s | %12d \n", "compact_threshold", compactInfo.threshold);
+}
+
+//records a translated access: sets the referenced bit, the dirty bit on writes, and
+//stamps the page with the access clock for working set estimation
+void touchPage(Process *process, int pageNumber, bool write) {
+    PageUnit &page = process->pageTable[pageNumber];
+    accessInfo.clock++;
+    page.referenced = 1;
+    if(write) {
+        page.dirty = 1;
+    }
+    page.lastAccess = accessInfo.clock;
+    if(!adviseInfo.coldPages.empty()) {
+        adviseInfo.coldPages.erase(make_pair(process->pid, pageNumber)); //used again, no longer cold
+    }
+    process->accesses++;
+    if(page.frameNumber != -1 && frameNode(page.frameNumber) == process->numaNode) {
+        process->localAccesses++;
+    } else {
+        process->remoteAccesses++;
+    }
+    if(page.mapping != -1 && page.frameNumber != -1) {
+        auto entryIt = pageCache.entries.find(pageCacheKey(page));
+        if(entryIt != pageCache.entries.end()) {
+            entryIt->second.referenced = 1;
+        }
+    }
+    syncCurrentPage(process, page);
+}
+
+//the working set is every page accessed within the last accessInfo.window accesses
+void printWorkingSet(int pid) {
+    Process *process = processTable.table[pid];
+    long long since = accessInfo.clock - accessInfo.window;
+    int pagesWithData = 0;
+    int resident = 0;
+    int swapped = 0;
+    int referenced = 0;
+    int dirty = 0;
+    int pinned = 0;
+    int workingSet = 0;
+    for(PageUnit *entry : process->pageTable.entries()) {
+        const PageUnit &page = *entry;
+        if(page.frameNumber == -1 && page.inMem == 0) {
+            continue;
+        }
+        pagesWithData++;
+        if(page.inMem == 1) {
+            swapped++;
+        } else {
+            resident++;
+        }
+        referenced += page.referenced;
+        dirty += page.dirty;
+        if(page.pinned > 0) {
+            pinned++;
+        }
+        if(page.lastAccess > 0 && page.lastAccess > since) {
+            workingSet++;
+        }
+    }
+    printf("|%24s | %12d \n", "Working Set of PID", pid);
+    printf("+-------------------------+--------------\n");
+    printf("| %23s | %12lld \n", "window (accesses)", accessInfo.window);
+    printf("| %23s | %12d \n", "pages with data", pagesWithData);
+    printf("| %23s | %12d \n", "resident pages", resident);
+    printf("| %23s | %12d \n", "swapped pages", swapped);
+    printf("| %23s | %12d \n", "referenced pages", referenced);
+    printf("| %23s | %12d \n", "dirty pages", dirty);
+    printf("| %23s | %12d \n", "pinned pages", pinned);
+    printf("| %23s | %12d \n", "working set pages", workingSet);
+    printf("| %23s | %12lld \n", "working set bytes", (long long)workingSet * commandInput.pageSize);
+    printf("| %23s | %12lld \n", "accesses", process->accesses);
+    printf("| %23s | %12lld \n", "swap-in faults", process->faults);
+}
+
+void reclaimStart() {
+    reclaimSetWatermarks();
+    reclaimInfo.worker = thread(reclaimWorker);
+}
+
+//default watermarks for the current page size
+void reclaimSetWatermarks() {
+    int ramFrames = 67108864 / commandInput.pageSize;
+    reclaimInfo.lowWatermark = ramFrames / 64;
+    reclaimInfo.highWatermark = ramFrames / 32;
+}
+
+//called by the exit command with mainInfo.lock released
+void reclaimShutdown() {
+    if(!reclaimInfo.worker.joinable()) {
+        return;
+    }
+    reclaimInfo.stop = true;
+    reclaimInfo.wake.notify_one();
+    reclaimInfo.worker.join();
+}
+
+//runs at exit, the reclaimer is only still running if the simulator exited from
+//inside a command, which still holds mainInfo.lock, so it cannot be joined
+void reclaimAbandon() {
+    if(reclaimInfo.worker.joinable()) {
+        reclaimInfo.stop = true;
+        reclaimInfo.worker.detach();
+    }
+}
+
+void reclaimWorker() {
+    unique_lock<mutex> lk(mainInfo.lock);
+    while(!reclaimInfo.stop) {
+        //also poll, frames freed by free/terminate never signal the reclaimer
+        reclaimInfo.wake.wait_for(lk, chrono::milliseconds(100), [] {
+            return reclaimInfo.stop || freeFrameCount() < reclaimInfo.lowWatermark;
+        });
+        if(reclaimInfo.stop || freeFrameCount() >= reclaimInfo.lowWatermark) {
+            continue;
+        }
+        reclaimInfo.wakeups++;
+        reclaimPass(&lk);
+    }
+}
+
+//swaps out pages until highWatermark frames are free or nothing is left to evict.
+//Only runs where no command is half way through its changes: in the reclaimer, which
+//then gives lk up between batches so a waiting command gets in, or between the
+//operations of a workload with lk NULL.
+void reclaimPass(unique_lock<mutex> *lk) {
+    int batch = 0;
+    while(!reclaimInfo.stop && freeFrameCount() < reclaimInfo.highWatermark) {
+        if(!switchMem(-1, -1, -1)) {
+            break;
+        }
+        reclaimInfo.pagesReclaimed++;
+        if(++batch == RECLAIM_BATCH && lk != NULL) {
+            batch = 0;
+            lk->unlock();
+            this_thread::yield();
+            lk->lock();
+        }
+    }
+}
+
+void printReclaim() {
+    printf("|%24s | %12s \n", "Reclaim Counter", "Value");
+    printf("+-------------------------+--------------\n");
+    printf("| %23s | %12d \n", "free frames", freeFrameCount());
+    printf("| %23s | %12d \n", "low watermark", reclaimInfo.lowWatermark);
+    printf("| %23s | %12d \n", "high watermark", reclaimInfo.highWatermark);
+    printf("| %23s | %12lld \n", "reclaimer wakeups", reclaimInfo.wakeups);
+    printf("| %23s | %12lld \n", "workload passes", reclaimInfo.workloadPasses);
+    printf("| %23s | %12lld \n", "pages reclaimed", reclaimInfo.pagesReclaimed);
+    printf("| %23s | %12lld \n", "direct reclaims", reclaimInfo.directReclaims);
+}
+
+//frames pageHandler will ask for to place size more bytes in the process
+int pagesNeeded(Process *process, int size) {
+    if(process->tailSpace > 0 && size <= process->tailSpace) {
+        return 0;
+    }
+    //a full current page moves pageHandler on to a fresh page even to place nothing
+    return max((size - process->tailSpace + commandInput.pageSize - 1) / commandInput.pageSize, 1);
+}
+
+//makes sure pages more pages can be handed to pid (-1 for a process that does not
+//exist yet). Quotas are checked first, then while RAM plus swap cannot hold the pages
+//the OOM killer terminates the process with the highest badness. False if the quota
+//would be broken, nothing is left to kill, or pid itself was the one killed.
+bool reserveMemory(int pid, int pages) {
+    Process *process = processTable.table.count(pid) == 1 ? processTable.table[pid] : NULL;
+    //each quota caps its own side, an unset one is as large as RAM or swap
+    if(process != NULL && (process->rssQuota > 0 || process->swapQuota > 0)) {
+        long long rssLimit = process->rssQuota > 0 ? process->rssQuota : 67108864 / commandInput.pageSize;
+        long long swapLimit = process->swapQuota > 0 ? process->swapQuota : SWAP_SIZE / commandInput.pageSize;
+        if((long long)process->residentPages + process->swappedPages + pages > rssLimit + swapLimit) {
+            cout << "Process " << pid << " would exceed its memory quota" << endl;
+            oomInfo.quotaDenials++;
+            return false;
+        }
+    }
+    while(true) {
+        long long swapLeft = SWAP_SIZE / commandInput.pageSize - (long long)swapSpace.swapMap.size()
+                             - (long long)zswapPool.entries.size();
+        //cached file pages can be dropped whenever their frames are needed
+        if(freeFrameCount() + (long long)pageCache.entries.size() + swapLeft >= pages) {
+            return true;
+        }
+        if(!oomKill(-1, pid)) {
+            cout << "Out of memory: no room for " << pages << " more pages" << endl;
+            return false;
+        }
+        if(pid != -1 && processTable.table.count(pid) == 0) {
+            return false;
+        }
+    }
+}
+
+//pages the process holds in RAM and in swap, the process with the most is killed first
+int oomBadness(Process *process) {
+    return process->residentPages + process->swappedPages;
+}
+
+//terminates the process with the highest badness other than excludePid, the
+//youngest one on a tie, false if there is no process to kill
+bool oomKill(int excludePid, int requesterPid) {
+    Process *victim = NULL;
+    for(auto const& processLoc : processTable.table) {
+        if(processLoc.first == excludePid) {
+            continue;
+        }
+        if(victim == NULL || oomBadness(processLoc.second) >= oomBadness(victim)) {
+            victim = processLoc.second;
+        }
+    }
+    if(victim == NULL) {
+        return false;
+    }
+    cout << "Out of memory: killed process " << victim->pid << " (badness " << oomBadness(victim) << ")";
+    if(requesterPid != -1 && requesterPid != victim->pid) {
+        cout << " to make room for process " << requesterPid;
+    }
+    cout << endl;
+    oomInfo.kills++;
+    terminatePID(victim->pid);
+    return true;
+}
+
+//a quota below what the process uses now takes effect right away: pages over an RSS
+//quota are swapped out, pages over a swap quota are brought back into RAM. If the
+//process cannot get under the new quota it is refused and the old one stays.
+void setQuota(int pid, string kind, int pages) {
+    Process *process = processTable.table[pid];
+    if(kind == "rss") {
+        int old = process->rssQuota;
+        int excess = pages > 0 ? process->residentPages - pages : 0;
+        if(excess > 0 && process->swapQuota > 0 && process->swappedPages + excess > process->swapQuota) {
+            cout << "Process " << pid << " has no room in its swap quota to get down to " << pages
+                 << " resident pages, the quota was not changed" << endl;
+            return;
+        }
+        process->rssQuota = pages;
+        while(pages > 0 && process->residentPages > pages && switchMem(-1, -1, pid)) {
+            oomInfo.quotaReclaims++;
+        }
+        if(pages > 0 && process->residentPages > pages) {
+            process->rssQuota = old;
+            cout << "Process " << pid << " cannot get down to " << pages
+                 << " resident pages, the quota was not changed" << endl;
+        }
+    } else {
+        int old = process->swapQuota;
+        int excess = pages > 0 ? process->swappedPages - pages : 0;
+        if(excess > 0 && process->rssQuota > 0 && process->residentPages + excess > process->rssQuota) {
+            cout << "Process " << pid << " has no room in its RSS quota to get down to " << pages
+                 << " swapped pages, the quota was not changed" << endl;
+            return;
+        }
+        //set first, a process over its swap quota has none of its pages evicted meanwhile
+        process->swapQuota = pages;
+        if(excess > 0) {
+            for(PageUnit *page : process->pageTable.entries()) {
+                if(process->swappedPages <= pages) {
+                    break;
+                }
+                if(page->inMem != 1) {
+                    continue;
+                }
+                //make room by eviction only, a quota change never calls the OOM killer
+                if(freeFrameCount() == 0 && !switchMem(pid, page->pageNumber, -1)) {
+                    break;
+                }
+                if(pageFrameAddress(process, page->pageNumber) == NULL) {
+                    break;
+                }
+            }
+        }
+        if(pages > 0 && process->swappedPages > pages) {
+            process->swapQuota = old;
+            cout << "Process " << pid << " cannot get down to " << pages
+                 << " swapped pages, the quota was not changed" << endl;
+        }
+    }
+}
+
+void printQuota() {
+    printf("| %4s | %9s | %9s | %9s | %10s | %8s \n", "PID", "RSS", "RSS Quota", "Swap", "Swap Quota", "Badness");
+    printf("+------+-----------+-----------+-----------+------------+----------\n");
+    for(auto const& processLoc : processTable.table) {
+        Process *process = processLoc.second;
+        string rssQuota = process->rssQuota == 0 ? "-" : to_string(process->rssQuota);
+        string swapQuota = process->swapQuota == 0 ? "-" : to_string(process->swapQuota);
+        printf("| %4d | %9d | %9s | %9d | %10s | %8d \n", process->pid, process->residentPages, rssQuota.c_str(),
+               process->swappedPages, swapQuota.c_str(), oomBadness(process));
+    }
+    printf("OOM kills: %lld, quota denials: %lld, quota reclaims: %lld\n", oomInfo.kills, oomInfo.quotaDenials,
+           oomInfo.quotaReclaims);
+}
+
+//resizes a variable, a pinned variable stays pinned on whatever pages it ends up in
+void reallocVariable(int pid, string name, int amount) {
+    Process *process = processTable.table[pid];
+    MMUObject &mmu = mmuTable.table.at(to_string(pid)+name);
+    if(!mmu.pinned) {
+        resizeVariable(pid, name, amount);
+        return;
+    }
+    pinPages(process, mmu, -1);
+    resizeVariable(pid, name, amount);
+    if(processTable.table.count(pid) == 1) {
+        MMUObject &resized = mmuTable.table.at(to_string(pid)+name);
+        pinPages(process, resized, 1);
+        if(!populateVariable(process, resized)) {
+            cout << "Out of memory while bringing " << name << " back into RAM" << endl;
+        }
+    }
+}
+
+//Growth stays in place when the free extent after the variable and the pages after
+//its last byte are unused, otherwise the data moves to a new placement
+void resizeVariable(int pid, string name, int amount) {
+    Process *process = processTable.table[pid];
+    MMUObject mmu = mmuTable.table.at(to_string(pid)+name);
+    long long newSize = (long long)amount * typeCodeSize(mmu.typeCode);
+    if(mmu.mapping != -1) {
+        cout << name << " maps a file and cannot be resized" << endl;
+        return;
+    }
+    //offsets into a variable are ints, and growth has to fit in the free extents
+    long long freeVirtual = 0;
+    for(auto it = mmuFirst(pid), end = mmuPast(pid); it != end; ++it) {
+        if(it->second.name == "freeSpace" && it->second.pid == pid) {
+            freeVirtual += it->second.size;
+        }
+    }
+    if(newSize > INT_MAX || newSize - mmu.size > freeVirtual) {
+        cout << "Process " << pid << " does not have enough free virtual memory for " << name << endl;
+        return;
+    }
+
+    if(newSize < mmu.size) {
+        //hand the tail pieces back to their pages, last page first
+        MMUObject tail;
+        int cut = mmu.size - newSize;
+        for(auto it = mmu.pageInfo.rbegin(); it != mmu.pageInfo.rend() && cut > 0; ++it) {
+            int take = min(it->second, cut);
+            tail.pageInfo[it->first] = take;
+            it->second -= take;
+            cut -= take;
+        }
+        for(auto const& loc : tail.pageInfo) {
+            if(mmu.pageInfo[loc.first] == 0) {
+                mmu.pageInfo.erase(loc.first);
+            }
+        }
+        freeFromPage(process, tail);
+        releaseVirtualRange(pid, mmu.address + newSize, mmu.size - newSize);
+        mmu.size = newSize;
+        mmuTable.table[mmu.key] = mmu;
+        cout << mmu.physicalAddr << endl;
+        return;
+    }
+    if(newSize == mmu.size) {
+        cout << mmu.physicalAddr << endl;
+        return;
+    }
+
+    //virtual side: extend into the free extent that starts right after the variable,
+    //or find a range for the whole new size
+    int delta = newSize - mmu.size;
+    string adjacentKey = "N/A";
+    for(auto it = mmuFirst(pid), end = mmuPast(pid); it != end; ++it) {
+        if(it->second.name == "freeSpace" && it->second.pid == pid && it->second.address == mmu.address + mmu.size
+           && it->second.size >= delta) {
+            adjacentKey = it->first;
+        }
+    }
+    string movedKey = "N/A";
+    if(adjacentKey == "N/A") {
+        movedKey = findFreeSpaceMMU(newSize, pid);
+    }
+    bool inPlace = canGrowInPlace(process, mmu, delta);
+    int placedSize = inPlace ? delta : newSize;
+    if((adjacentKey == "N/A" && movedKey == "N/A") || placedSize > process->totalPageRemainSpace) {
+        cout << "Process " << pid << " does not have enough free virtual memory for " << name << endl;
+        return;
+    }
+    if(!reserveMemory(pid, pagesNeeded(process, placedSize))) {
+        return;
+    }
+
+    //physical side: place only the extra bytes when growing in place, the whole
+    //variable otherwise, under a temporary key pageHandler can record it with
+    MMUObject placed;
+    placed.pid = pid;
+    placed.name = name;
+    placed.typeCode = mmu.typeCode;
+    placed.size = placedSize;
+    placed.set = mmu.set;
+    placed.key = mmu.key + "#realloc";
+    bool placedOk = pageHandler(process, placed);
+    auto placedIt = mmuTable.table.find(placed.key);
+    if(placedIt != mmuTable.table.end()) {
+        placed = placedIt->second;
+        mmuTable.table.erase(placedIt);
+    }
+    if(!placedOk) {
+        freeFromPage(process, placed);
+        return;
+    }
+    if(inPlace) {
+        for(auto const& loc : placed.pageInfo) {
+            mmu.pageInfo[loc.first] += loc.second;
+        }
+    } else {
+        moveVariableData(process, mmu, placed);
+        freeFromPage(process, mmu);
+        mmu.pageInfo = placed.pageInfo;
+        mmu.pageNumber = placed.pageNumber;
+        mmu.frameNumber = placed.frameNumber;
+        mmu.physicalAddr = placed.physicalAddr;
+    }
+
+    if(adjacentKey != "N/A") {
+        MMUObject &freeSpace = mmuTable.table.at(adjacentKey);
+        freeSpace.address += delta;
+        freeSpace.size -= delta;
+        if(freeSpace.size == 0) {
+            mmuTable.table.erase(adjacentKey);
+        }
+    } else {
+        long long oldAddress = mmu.address;
+        MMUObject &freeSpace = mmuTable.table.at(movedKey);
+        mmu.address = freeSpace.address;
+        freeSpace.address += newSize;
+        freeSpace.size -= newSize;
+        if(freeSpace.size == 0) {
+            mmuTable.table.erase(movedKey);
+        }
+        releaseVirtualRange(pid, oldAddress, mmu.size);
+    }
+    mmu.size = newSize;
+    mmuTable.table[mmu.key] = mmu;
+    cout << mmu.physicalAddr << endl;
+}
+
+//bytes per element of a variable type code
+int typeCodeSize(int typeCode) {
+    switch(typeCode) {
+        case 1 : return 1;
+        case 2 : return 2;
+        case 4 :
+        case 5 : return 8;
+        default : return 4;
+    }
+}
+
+//the pieces of a variable in order, see copyToVariable for the layout
+vector<PageRun> variableRuns(const MMUObject& mmu) {
+    vector<PageRun> runs;
+    int offset = mmu.physicalAddr % commandInput.pageSize;
+    for(auto const& loc : mmu.pageInfo) {
+        runs.push_back({loc.first, offset, loc.second});
+        offset = 0;
+    }
+    return runs;
+}
+
+//true if pageHandler would put the next delta bytes right after the last byte of mmu:
+//the variable ends where the current page is filled up to and every page the extra
+//bytes spill into is still empty
+bool canGrowInPlace(Process *process, const MMUObject& mmu, int delta) {
+    if(mmu.pageInfo.empty()) {
+        return false;
+    }
+    PageRun last = variableRuns(mmu).back();
+    int pageNumber = last.pageNumber;
+    int freeAfter = commandInput.pageSize - (last.offset + last.length);
+    if(freeAfter == 0) {
+        //a variable that fills its last page continues at the start of the next one
+        pageNumber++;
+        freeAfter = commandInput.pageSize;
+    }
+    if(pageNumber != process->currentPage.pageNumber || process->tailSpace != freeAfter) {
+        return false;
+    }
+    for(int remain = delta - freeAfter; remain > 0; remain -= commandInput.pageSize) {
+        pageNumber++;
+        if(pageNumber >= process->pages || process->pageTable[pageNumber].freeSpace != commandInput.pageSize) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//copies the bytes of from into the start of to one page run at a time. Runs that fill
+//a whole page on both sides are remapped instead, the two pages swap frames so the
+//data never moves, as long as both are in RAM.
+void moveVariableData(Process *process, const MMUObject& from, const MMUObject& to) {
+    vector<PageRun> src = variableRuns(from);
+    vector<PageRun> dst = variableRuns(to);
+    vector<uint8_t> bounce(commandInput.pageSize);
+    int pageSize = commandInput.pageSize;
+    size_t i = 0, j = 0;
+    int srcDone = 0, dstDone = 0; //bytes of src[i] and dst[j] already handled
+    while(i < src.size() && j < dst.size()) {
+        PageUnit &srcPage = process->pageTable[src[i].pageNumber];
+        PageUnit &dstPage = process->pageTable[dst[j].pageNumber];
+        if(srcDone == 0 && dstDone == 0 && src[i].length == pageSize && dst[j].length == pageSize
+           && srcPage.inMem == 0 && srcPage.frameNumber != -1 && dstPage.inMem == 0 && dstPage.frameNumber != -1) {
+            swap(srcPage.frameNumber, dstPage.frameNumber);
+            swap(srcPage.referenced, dstPage.referenced);
+            swap(srcPage.dirty, dstPage.dirty);
+            swap(srcPage.lastAccess, dstPage.lastAccess);
+            frameTable.table[srcPage.frameNumber] = srcPage;
+            frameTable.table[dstPage.frameNumber] = dstPage;
+            syncCurrentPage(process, srcPage);
+            syncCurrentPage(process, dstPage);
+            i++;
+            j++;
+            continue;
+        }
+        //through a bounce buffer, faulting the destination in may evict the source
+        int amount = min(src[i].length - srcDone, dst[j].length - dstDone);
+        uint8_t *srcAddr = pageFrameAddress(process, src[i].pageNumber);
+        if(srcAddr == NULL) {
+            cout << "Out of memory: page " << src[i].pageNumber << " of process " << process->pid << " is not in RAM" << endl;
+            return;
+        }
+        memcpy(bounce.data(), srcAddr + src[i].offset + srcDone, amount);
+        uint8_t *dstAddr = pageFrameAddress(process, dst[j].pageNumber);
+        if(dstAddr == NULL) {
+            cout << "Out of memory: page " << dst[j].pageNumber << " of process " << process->pid << " is not in RAM" << endl;
+            return;
+        }
+        memcpy(dstAddr + dst[j].offset + dstDone, bounce.data(), amount);
+        touchPage(process, dst[j].pageNumber, true);
+        srcDone += amount;
+        dstDone += amount;
+        if(srcDone == src[i].length) {
+            i++;
+            srcDone = 0;
+        }
+        if(dstDone == dst[j].length) {
+            j++;
+            dstDone = 0;
+        }
+    }
+}
+
+//frees the pages of the process and places its variables again in address order,
+//packed from page 0, with their virtual ranges packed from address 0 the same way.
+//Variables with a swapped out page stay on their pages, bringing them back in could
+//evict or OOM kill. The new layout is planned first and only takes frames that are
+//free once the old ones are handed back, if that is not enough nothing is moved.
+void compactProcess(int pid) {
+    if(hasFileMappings(pid)) {
+        //mapped pages belong to their file, they cannot be repacked with the rest
+        cout << "Process " << pid << " has mapped files and cannot be compacted" << endl;
+        return;
+    }
+    Process *process = processTable.table[pid];
+    int pageSize = commandInput.pageSize;
+    int pagesBefore = process->residentPages + process->swappedPages;
+
+    vector<MMUObject> variables;
+    for(auto it = mmuFirst(pid), end = mmuPast(pid); it != end; ++it) {
+        if(it->second.pid == pid && it->second.name != "freeSpace") {
+            variables.push_back(it->second);
+        }
+    }
+    sort(variables.begin(), variables.end(), [](const MMUObject& a, const MMUObject& b) {
+        return a.address < b.address;
+    });
+
+    //the pages of variables that are partly swapped out are kept as they are
+    vector<bool> moved(variables.size(), true);
+    set<int> keptPages;
+    int keptVariables = 0;
+    for(size_t v=0; v<variables.size(); v++) {
+        for(auto const& loc : variables[v].pageInfo) {
+            if(process->pageTable[loc.first].inMem == 1) {
+                moved[v] = false;
+            }
+        }
+        if(!moved[v]) {
+            keptVariables++;
+            for(auto const& loc : variables[v].pageInfo) {
+                keptPages.insert(loc.first);
+            }
+        }
+    }
+
+    //plan the moved variables the way pageHandler places them, on the other pages
+    vector<map<int, int>> plannedInfo(variables.size());
+    vector<int> plannedOffset(variables.size(), 0);
+    vector<int> plannedFirst(variables.size(), -1);
+    vector<int> newPages;
+    int pageNumber = -1;
+    int tail = 0;
+    bool fits = true;
+    for(size_t v=0; v<variables.size() && fits; v++) {
+        if(!moved[v]) {
+            continue;
+        }
+        int remain = (int)variables[v].size;
+        do {
+            if(tail == 0) {
+                do {
+                    pageNumber++;
+                } while(keptPages.count(pageNumber) == 1);
+                if(pageNumber >= process->pages) {
+                    fits = false;
+                    break;
+                }
+                newPages.push_back(pageNumber);
+                tail = pageSize;
+            }
+            if(plannedFirst[v] == -1) {
+                plannedFirst[v] = pageNumber;
+                plannedOffset[v] = pageSize - tail;
+            }
+            int stored = min(remain, tail);
+            if(stored > 0) {
+                plannedInfo[v][pageNumber] = stored;
+            }
+            remain -= stored;
+            tail -= stored;
+        } while(remain > 0);
+    }
+    int releasedFrames = 0;
+    int keptResident = 0;
+    for(PageUnit *entry : process->pageTable.entries()) {
+        if(entry->frameNumber != -1 && entry->inMem == 0) {
+            if(keptPages.count(entry->pageNumber) == 1) {
+                keptResident++;
+            } else {
+                releasedFrames++;
+            }
+        }
+    }
+    int residentAfter = keptResident + (int)newPages.size();
+    if(!fits || (int)newPages.size() > releasedFrames + freeFrameCount()
+       || (process->rssQuota > 0 && residentAfter > max(process->rssQuota, process->residentPages))) {
+        cout << "Compaction of process " << pid << " needs more pages or frames than it can get, nothing was moved" << endl;
+        return;
+    }
+
+    //take the bytes of the moved variables out of RAM, their pages are all resident or
+    //never got a frame
+    map<int, vector<uint8_t>> pageData;
+    for(size_t v=0; v<variables.size(); v++) {
+        if(!moved[v]) {
+            continue;
+        }
+        if(variables[v].pinned) {
+            pinPages(process, variables[v], -1);
+        }
+        for(auto const& loc : variables[v].pageInfo) {
+            PageUnit &page = process->pageTable[loc.first];
+            if(page.frameNumber != -1 && pageData.count(loc.first) == 0) {
+                uint8_t *frameAddr = mainInfo.mem + (long)page.frameNumber * pageSize;
+                pageData[loc.first].assign(frameAddr, frameAddr + pageSize);
+            }
+            if(keptPages.count(loc.first) == 1) {
+                page.freeSpace += loc.second; //a hole in a kept page
+            }
+        }
+    }
+    //hand back every page that is not kept and start over with a fresh page table
+    map<int, PageUnit> keptEntries;
+    for(PageUnit *entry : process->pageTable.entries()) {
+        const PageUnit &page = *entry;
+        if(keptPages.count(page.pageNumber) == 1) {
+            keptEntries[page.pageNumber] = page;
+        } else if(page.inMem == 1) {
+            releaseSwappedPage(pid, page.pageNumber);
+        } else if(page.frameNumber != -1) {
+            frameTable.table.erase(page.frameNumber);
+            releaseFrame(page.frameNumber);
+        }
+    }
+    process->pageTable.init(pid, process->pages);
+    forgetColdPages(pid); //the page numbers are about to change
+    for(auto const& loc : keptEntries) {
+        process->pageTable[loc.first] = loc.second;
+    }
+    for(int newPage : newPages) {
+        PageUnit &page = process->pageTable[newPage];
+        page.frameNumber = takeFreeFrame(process, newPage, false);
+        page.referenced = 1;
+        page.dirty = 1;
+        memset(mainInfo.mem + (long)page.frameNumber * pageSize, 0, pageSize);
+    }
+
+    for(size_t v=0; v<variables.size(); v++) {
+        if(!moved[v]) {
+            continue;
+        }
+        MMUObject &variable = variables[v];
+        MMUObject placed = variable;
+        placed.pageInfo = plannedInfo[v];
+        placed.pageNumber = plannedFirst[v];
+        placed.frameNumber = process->pageTable[plannedFirst[v]].frameNumber;
+        placed.physicalAddr = placed.frameNumber * pageSize + plannedOffset[v];
+        for(auto const& loc : placed.pageInfo) {
+            process->pageTable[loc.first].freeSpace -= loc.second;
+        }
+        //copy the old pieces into the new ones one page run at a time
+        vector<PageRun> src = variableRuns(variable);
+        vector<PageRun> dst = variableRuns(placed);
+        size_t i = 0, j = 0;
+        int srcDone = 0, dstDone = 0;
+        while(i < src.size() && j < dst.size()) {
+            int amount = min(src[i].length - srcDone, dst[j].length - dstDone);
+            uint8_t *dstAddr = mainInfo.mem + (long)process->pageTable[dst[j].pageNumber].frameNumber * pageSize;
+            auto srcData = pageData.find(src[i].pageNumber);
+            if(srcData != pageData.end()) {
+                memcpy(dstAddr + dst[j].offset + dstDone, srcData->second.data() + src[i].offset + srcDone, amount);
+            } //a piece whose page never got a frame reads as zeros, as the new page does
+            srcDone += amount;
+            dstDone += amount;
+            if(srcDone == src[i].length) {
+                i++;
+                srcDone = 0;
+            }
+            if(dstDone == dst[j].length) {
+                j++;
+                dstDone = 0;
+            }
+        }
+        if(placed.pinned) {
+            pinPages(process, placed, 1);
+        }
+        variable = placed;
+    }
+
+    //the process counters follow the new page table
+    process->residentPages = 0;
+    process->swappedPages = 0;
+    process->totalPageRemainSpace = (long long)process->pages * pageSize;
+    for(PageUnit *entry : process->pageTable.entries()) {
+        if(entry->inMem == 1) {
+            process->swappedPages++;
+        } else if(entry->frameNumber != -1) {
+            process->residentPages++;
+            frameTable.table[entry->frameNumber] = *entry;
+        }
+        process->totalPageRemainSpace -= pageSize - entry->freeSpace;
+    }
+    if(pageNumber == -1) {
+        //nothing was moved, continue on the first page that is not kept
+        pageNumber = 0;
+        while(keptPages.count(pageNumber) == 1 && pageNumber < process->pages - 1) {
+            pageNumber++;
+        }
+        tail = keptPages.count(pageNumber) == 1 ? 0 : pageSize;
+    }
+    process->currentPage = process->pageTable[pageNumber];
+    process->tailSpace = tail;
+
+    //virtual side: every variable packed from address 0
+    for(auto it = mmuFirst(pid), end = mmuPast(pid); it != end; ) {
+        if(it->second.pid == pid && it->second.name == "freeSpace") {
+            it = mmuTable.table.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    long long address = 0;
+    for(MMUObject &variable : variables) {
+        variable.address = address;
+        address += variable.size;
+        mmuTable.table[variable.key] = variable;
+    }
+    if(address < (1LL << process->addressBits)) {
+        MMUObject freeSpace;
+        freeSpace.name = "freeSpace";
+        freeSpace.pid = pid;
+        freeSpace.address = address;
+        freeSpace.size = (1LL << process->addressBits) - address;
+        freeSpace.typeCode = 0;
+        freeSpace.key = to_string(pid) + freeSpace.name + to_string(freeSpace.address);
+        mmuTable.table.insert(std::pair<string, MMUObject>(freeSpace.key,freeSpace));
+    }
+
+    int pagesAfter = process->residentPages + process->swappedPages;
+    cout << "Compacted process " << pid << " from " << pagesBefore << " to " << pagesAfter << " pages";
+    if(keptVariables > 0) {
+        cout << ", " << keptVariables << " variables with swapped out pages stayed in place";
+    }
+    cout << endl;
+}
+
+//automatic mode: compacts the process once more than compactInfo.threshold percent of
+//the pages it holds could be given back
+void compactIfFragmented(int pid) {
+    if(compactInfo.threshold == 0 || processTable.table.count(pid) == 0 || hasFileMappings(pid)) {
+        return;
+    }
+    Process *process = processTable.table[pid];
+    long long liveBytes = 0;
+    for(auto it = mmuFirst(pid), end = mmuPast(pid); it != end; ++it) {
+        if(it->second.pid == pid && it->second.name != "freeSpace") {
+            liveBytes += it->second.size;
+        }
+    }
+    int held = process->residentPages + process->swappedPages;
+    //the last page the process placed into is usually only partly filled
+    int needed = (int)(liveBytes / commandInput.pageSize) + 1;
+    if(held - needed > 1 && (held - needed) * 100 >= compactInfo.threshold * held) {
+        compactProcess(pid);
+    }
+}
+
+//hands out a process from processPool, or a new one
+Process *acquireProcess() {
+    if(processPool.spare.empty()) {
+        return new Process;
+    }
+    Process *process = processPool.spare.back();
+    processPool.spare.pop_back();
+    process->~Process();
+    new (process) Process;
+    return process;
+}
+
+//takes back a process that is no longer in the processTable, its page tables go to
+//pageTableSpares for whichever process needs tables next
+void releaseProcess(Process *process) {
+    process->pageTable.release();
+    if(processPool.spare.size() >= PROCESS_POOL_LIMIT) {
+        delete process;
+        return;
+    }
+    processPool.spare.push_back(process);
+}
+
+//sizes the table for pageCount pages: PAGE_TABLE_BITS per level, between 2 and 4
+//levels, with the root taking whatever bits are left over
+void PageTable::init(int ownerPid, int pageCount) {
+    release(); //with the old shape, it tells leaves from the tables above them
+    pid = ownerPid;
+    pages = pageCount;
+    int bits = 1;
+    while(bits < 31 && (1LL << bits) < pageCount) {
+        bits++;
+    }
+    levels = min(max((bits + PAGE_TABLE_BITS - 1) / PAGE_TABLE_BITS, 2), 4);
+    topBits = max(bits - PAGE_TABLE_BITS * (levels - 1), 1);
+    tables = 0;
+    bytes = 0;
+}
+
+PageUnit &PageTable::operator[](int pageNumber) {
+    unique_ptr<PageTableNode> *table = &root;
+    for(int level = 0; level < levels; level++) {
+        if(!*table) {
+            vector<unique_ptr<PageTableNode>> &spares = level == levels - 1 ? pageTableSpares.leaves
+                                                                             : pageTableSpares.tables;
+            if(spares.empty()) {
+                table->reset(new PageTableNode);
+            } else {
+                //every entry of a reused leaf is filled in below, a reused table has no children
+                *table = std::move(spares.back());
+                spares.pop_back();
+            }
+            tables++;
+            int size = 1 << (level == 0 ? topBits : PAGE_TABLE_BITS);
+            if(level == levels - 1) {
+                //a new leaf starts with empty pages
+                int first = pageNumber & ~((1 << PAGE_TABLE_BITS) - 1);
+                (*table)->entries.resize(size);
+                bytes += size * (long long)sizeof(PageUnit);
+                for(int i=0; i<size; i++) {
+                    PageUnit &page = (*table)->entries[i];
+                    page.pid = pid;
+                    page.pageSize = commandInput.pageSize;
+                    page.freeSpace = page.pageSize;
+                    page.pageNumber = first + i;
+                    page.frameNumber = -1; //marked for empty page
+                    page.inMem = 0;
+                    page.referenced = 0;
+                    page.dirty = 0;
+                    page.lastAccess = 0;
+                    page.mapping = -1;
+                    page.pinned = 0;
+                }
+            } else {
+                (*table)->children.resize(size);
+                bytes += size * (long long)sizeof(unique_ptr<PageTableNode>);
+            }
+        }
+        int shift = PAGE_TABLE_BITS * (levels - 1 - level);
+        int mask = (1 << (level == 0 ? topBits : PAGE_TABLE_BITS)) - 1;
+        int index = (pageNumber >> shift) & mask;
+        if(level == levels - 1) {
+            return (*table)->entries[index];
+        }
+        table = &(*table)->children[index];
+    }
+    return root->entries[0]; //not reached, levels is at least 2
+}
+
+void PageTable::release() {
+    vector<pair<unique_ptr<PageTableNode>, int>> stack; //table and its level
+    if(root) {
+        stack.push_back(make_pair(std::move(root), 0));
+    }
+    while(!stack.empty()) {
+        unique_ptr<PageTableNode> table = std::move(stack.back().first);
+        int level = stack.back().second;
+        stack.pop_back();
+        for(unique_ptr<PageTableNode> &child : table->children) {
+            if(child) {
+                stack.push_back(make_pair(std::move(child), level + 1));
+            }
+        }
+        table->children.clear();
+        vector<unique_ptr<PageTableNode>> &spares = level == levels - 1 ? pageTableSpares.leaves
+                                                                         : pageTableSpares.tables;
+        if(spares.size() < PAGE_TABLE_SPARE_LIMIT) {
+            spares.push_back(std::move(table));
+        }
+    }
+}
+
+PageUnit &PageTable::walk(int pageNumber) {
+    walks++;
+    walkSteps += levels;
+    return (*this)[pageNumber];
+}
+
+vector<PageUnit*> PageTable::entries() {
+    vector<PageUnit*> found;
+    vector<pair<PageTableNode*, int>> stack; //table and its level, depth first in index order
+    if(root) {
+        stack.push_back(make_pair(root.get(), 0));
+    }
+    while(!stack.empty()) {
+        PageTableNode *table = stack.back().first;
+        int level = stack.back().second;
+        stack.pop_back();
+        if(level == levels - 1) {
+            for(PageUnit &page : table->entries) {
+                if(page.pageNumber < pages) {
+                    found.push_back(&page);
+                }
+            }
+            continue;
+        }
+        for(auto child = table->children.rbegin(); child != table->children.rend(); ++child) {
+            if(*child) {
+                stack.push_back(make_pair(child->get(), level + 1));
+            }
+        }
+    }
+    return found;
+}
+
+//widest address space a process can have with the current page size: page numbers
+//have to fit in an int, and x86-64 stops at 48 bits
+int maxAddressBits() {
+    int pageBits = 0;
+    while((1 << pageBits) < commandInput.pageSize) {
+        pageBits++;
+    }
+    return min(48, 30 + pageBits);
+}
+
+void printPageTable(int pid) {
+    Process *process = processTable.table[pid];
+    PageTable &pageTable = process->pageTable;
+    printf("|%24s | %16s \n", "Page Table", "Value");
+    printf("+-------------------------+------------------\n");
+    printf("| %23s | %16d \n", "address bits", process->addressBits);
+    printf("| %23s | %16d \n", "pages", process->pages);
+    printf("| %23s | %16d \n", "levels", pageTable.levels);
+    printf("| %23s | %16d \n", "root index bits", pageTable.topBits);
+    printf("| %23s | %16lld \n", "tables allocated", pageTable.tables);
+    printf("| %23s | %16lld \n", "table bytes", pageTable.bytes);
+    printf("| %23s | %16lld \n", "page walks", pageTable.walks);
+    printf("| %23s | %16lld \n", "tables read by walks", pageTable.walkSteps);
+}
+
+//splits the RAM frames evenly over nodeCount nodes, the last node takes what is left
+void numaConfigure(int nodeCount) {
+    int ramFrames = 67108864 / commandInput.pageSize;
+    int perNode = ramFrames / nodeCount;
+    numaInfo.nodes.clear();
+    for(int i=0; i<nodeCount; i++) {
+        NumaNode node;
+        node.firstFrame = i * perNode;
+        node.frames = i == nodeCount - 1 ? ramFrames - node.firstFrame : perNode;
+        node.nextFresh = node.firstFrame;
+        numaInfo.nodes.push_back(node);
+    }
+}
+
+int frameNode(int frame) {
+    int perNode = numaInfo.nodes[0].frames;
+    return min(frame / perNode, (int)numaInfo.nodes.size() - 1);
+}
+
+//puts a frame back into the pool of its node
+void releaseFrame(int frame) {
+    numaInfo.nodes[frameNode(frame)].freed.insert(frame);
+}
+
+int numaPolicyCode(string name) {
+    if(name == "firsttouch") {
+        return NUMA_FIRST_TOUCH;
+    } else if(name == "interleave") {
+        return NUMA_INTERLEAVE;
+    }
+    return -1;
+}
+
+void printNuma() {
+    vector<int> residentPages(numaInfo.nodes.size(), 0);
+    for(auto const& loc : frameTable.table) {
+        residentPages[frameNode(loc.first)]++;
+    }
+    printf("|%5s | %11s | %9s | %9s | %9s \n", "Node", "First Frame", "Frames", "Free", "Used");
+    printf("+------+-------------+-----------+-----------+-----------\n");
+    for(size_t node = 0; node < numaInfo.nodes.size(); node++) {
+        printf("| %4zu | %11d | %9d | %9d | %9d \n", node, numaInfo.nodes[node].firstFrame, numaInfo.nodes[node].frames,
+               nodeFreeFrames(node), residentPages[node]);
+    }
+    printf("\n");
+    printf("|%5s | %4s | %10s | %12s | %12s | %8s \n", "PID", "Node", "Policy", "Local", "Remote", "Remote %");
+    printf("+------+------+------------+--------------+--------------+----------\n");
+    for(auto const& processLoc : processTable.table) {
+        Process *process = processLoc.second;
+        long long total = process->localAccesses + process->remoteAccesses;
+        printf("| %4d | %4d | %10s | %12lld | %12lld | %7.1f%% \n", process->pid, process->numaNode,
+               process->numaPolicy == NUMA_INTERLEAVE ? "interleave" : "firsttouch", process->localAccesses,
+               process->remoteAccesses, total == 0 ? 0.0 : 100.0 * process->remoteAccesses / total);
+    }
+}
+
+//maps length bytes of path from offset (to the end of the file if length is -1) as a
+//char variable of the process. The region takes whole pages after the current page,
+//which get no frame until they are first touched.
+void mapFile(int pid, string name, string path, long long offset, long long length) {
+    Process *process = processTable.table[pid];
+    int pageSize = commandInput.pageSize;
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        cout << "Could not open " << path << " for reading" << endl;
+        return;
+    }
+    struct stat info;
+    if(fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        close(fd);
+        cout << path << " is not a regular file" << endl;
+        return;
+    }
+    if(length == -1) {
+        length = info.st_size - offset;
+    }
+    if(offset % pageSize != 0) {
+        close(fd);
+        cout << "The offset must be a multiple of the page size" << endl;
+        return;
+    }
+    if(length <= 0 || offset + length > info.st_size) {
+        close(fd);
+        cout << "The mapped range must lie inside " << path << ", which is " << (long long)info.st_size << " bytes" << endl;
+        return;
+    }
+    if(length > INT_MAX) {
+        close(fd);
+        cout << "Process " << pid << " does not have enough free virtual memory for " << name << endl;
+        return;
+    }
+
+    int pageCount = (int)((length + pageSize - 1) / pageSize);
+    int firstPage = process->currentPage.pageNumber + 1;
+    bool room = (long long)firstPage + pageCount <= process->pages
+                && (long long)pageCount * pageSize <= process->totalPageRemainSpace;
+    for(int i=0; i<pageCount && room; i++) {
+        const PageUnit &page = process->pageTable[firstPage + i];
+        room = page.freeSpace == pageSize && page.frameNumber == -1 && page.inMem == 0;
+    }
+    string freeSpaceMMUKey = findFreeSpaceMMU((int)length, pid);
+    if(!room || freeSpaceMMUKey == "N/A") {
+        close(fd);
+        cout << "Process " << pid << " does not have enough free virtual memory for " << name << endl;
+        return;
+    }
+
+    //mappings of the same file share its cached pages
+    int fileId;
+    auto idIt = pageCache.fileIds.find(make_pair(info.st_dev, info.st_ino));
+    if(idIt == pageCache.fileIds.end()) {
+        fileId = pageCache.nextFileId++;
+        MappedFile &file = pageCache.files[fileId];
+        file.path = path;
+        file.fd = fd;
+        file.device = info.st_dev;
+        file.inode = info.st_ino;
+        pageCache.fileIds[make_pair(info.st_dev, info.st_ino)] = fileId;
+    } else {
+        fileId = idIt->second;
+        close(fd);
+    }
+    pageCache.files[fileId].mappings++;
+    int mappingId = pageCache.nextMapping++;
+    FileMapping &mapping = pageCache.mappings[mappingId];
+    mapping.fileId = fileId;
+    mapping.pid = pid;
+    mapping.firstPage = firstPage;
+    mapping.offset = offset;
+    mapping.length = length;
+
+    MMUObject mmu;
+    mmu.pid = pid;
+    mmu.name = name;
+    mmu.typeCode = 1;
+    mmu.size = length;
+    mmu.set = true; //the file already holds the values
+    mmu.key = to_string(pid) + name;
+    mmu.mapping = mappingId;
+    mmu.pageNumber = firstPage;
+    mmu.frameNumber = -1;
+    mmu.physicalAddr = 0; //the region starts at the beginning of its first page
+    for(int i=0; i<pageCount; i++) {
+        PageUnit &page = process->pageTable[firstPage + i];
+        page.freeSpace = 0; //the whole page belongs to the mapping
+        page.mapping = mappingId;
+        mmu.pageInfo[firstPage + i] = (int)min((long long)pageSize, length - (long long)i * pageSize);
+    }
+    process->totalPageRemainSpace -= (long long)pageCount * pageSize;
+
+    mmu.address = mmuTable.table.at(freeSpaceMMUKey).address;
+    mmuTable.table.at(freeSpaceMMUKey).address = mmu.address + mmu.size;
+    mmuTable.table.at(freeSpaceMMUKey).size = mmuTable.table.at(freeSpaceMMUKey).size - mmu.size;
+    if(mmuTable.table.at(freeSpaceMMUKey).size == 0) {
+        mmuTable.table.erase(freeSpaceMMUKey);
+    }
+    mmuTable.table.insert(std::pair<string, MMUObject>(mmu.key, mmu));
+    cout << "Mapped " << length << " bytes of " << path << " into " << pageCount << " pages of process " << pid << endl;
+}
+
+//hands back every page of a mapped region: cached pages are only detached, pages the
+//process wrote to are released like any anonymous page
+void unmapRegion(Process *process, const MMUObject& mmu) {
+    for(auto const& loc : mmu.pageInfo) {
+        PageUnit &page = process->pageTable[loc.first];
+        if(page.mapping != -1) {
+            pageCacheDetach(process, page);
+        } else if(page.inMem == 1) {
+            releaseSwappedPage(process->pid, loc.first);
+            process->swappedPages--;
+        } else if(page.frameNumber != -1) {
+            frameTable.table.erase(page.frameNumber);
+            releaseFrame(page.frameNumber);
+            process->residentPages--;
+        }
+        page.freeSpace = page.pageSize;
+        page.frameNumber = -1;
+        page.inMem = 0;
+        page.referenced = 0;
+        page.dirty = 0;
+        page.lastAccess = 0;
+        page.mapping = -1;
+        page.pinned = 0;
+        syncCurrentPage(process, page);
+        process->totalPageRemainSpace += page.pageSize;
+    }
+    auto mappingIt = pageCache.mappings.find(mmu.mapping);
+    if(mappingIt != pageCache.mappings.end()) {
+        int fileId = mappingIt->second.fileId;
+        pageCache.mappings.erase(mappingIt);
+        pageCache.files[fileId].mappings--;
+        pageCacheForget(fileId);
+    }
+}
+
+bool hasFileMappings(int pid) {
+    for(auto const& loc : pageCache.mappings) {
+        if(loc.second.pid == pid) {
+            return true;
+        }
+    }
+    return false;
+}
+
+//(file id, page of the file) a mapped page reads from
+pair<int, long long> pageCacheKey(const PageUnit& page) {
+    const FileMapping &mapping = pageCache.mappings[page.mapping];
+    return make_pair(mapping.fileId, mapping.offset / commandInput.pageSize + page.pageNumber - mapping.firstPage);
+}
+
+//points a mapped page at its cached frame, reading the page from the file into a new
+//frame of the page cache first if it is not cached yet
+void filePageIn(Process *process, PageUnit& page) {
+    pair<int, long long> key = pageCacheKey(page);
+    auto entryIt = pageCache.entries.find(key);
+    if(entryIt == pageCache.entries.end()) {
+        int frame = allocateFrame(process->pid, page.pageNumber, true);
+        if(frame == -1) {
+            return;
+        }
+        uint8_t *frameAddr = mainInfo.mem + (long)frame * commandInput.pageSize;
+        memset(frameAddr, 0, commandInput.pageSize);
+        MappedFile &file = pageCache.files[key.first];
+        if(file.fd != -1 && pread(file.fd, frameAddr, commandInput.pageSize, key.second * commandInput.pageSize) < 0) {
+            cout << "Could not read " << file.path << ", the page reads as zeros" << endl;
+        }
+        file.cachedPages++;
+        pageCache.misses++;
+        entryIt = pageCache.entries.insert(make_pair(key, CacheEntry())).first;
+        entryIt->second.frame = frame;
+    } else {
+        pageCache.hits++;
+    }
+    entryIt->second.mappers.insert(make_pair(process->pid, page.pageNumber));
+    entryIt->second.referenced = 1;
+    page.frameNumber = entryIt->second.frame;
+    syncCurrentPage(process, page);
+}
+
+//takes a mapped page off its cached frame, the frame stays cached
+void pageCacheDetach(Process *process, PageUnit& page) {
+    if(page.frameNumber != -1) {
+        auto entryIt = pageCache.entries.find(pageCacheKey(page));
+        if(entryIt != pageCache.entries.end()) {
+            entryIt->second.mappers.erase(make_pair(process->pid, page.pageNumber));
+        }
+    }
+    page.frameNumber = -1;
+    syncCurrentPage(process, page);
+}
+
+//copy on write: a mapped page about to be written becomes an anonymous page with its
+//own copy of the cached data, the file and every other mapping keep the cached page.
+//The page must be in RAM, NULL if no frame is left for the copy.
+uint8_t *privatePageAddress(Process *process, int pageNumber) {
+    PageUnit &page = process->pageTable[pageNumber];
+    int pageSize = commandInput.pageSize;
+    //allocating the new frame may drop the cached one
+    vector<uint8_t> data(mainInfo.mem + (long)page.frameNumber * pageSize, mainInfo.mem + (long)(page.frameNumber + 1) * pageSize);
+    int frame = allocateFrame(process->pid, pageNumber, false);
+    if(frame == -1) {
+        return NULL;
+    }
+    pageCacheDetach(process, page);
+    uint8_t *frameAddr = mainInfo.mem + (long)frame * pageSize;
+    memcpy(frameAddr, data.data(), pageSize);
+    page.mapping = -1;
+    page.frameNumber = frame;
+    page.inMem = 0;
+    frameTable.table[frame] = page;
+    syncCurrentPage(process, page);
+    pageCache.copies++;
+    return frameAddr;
+}
+
+//clock over the page cache: drops the first cached page not referenced since the last
+//pass, unmapping it from every process using it. Cached pages are clean, so nothing is
+//written anywhere. A single lap clears the bits it passes, so false if the cache is empty
+//or every cached page was in use, and the anon clock gets its turn.
+bool pageCacheDrop() {
+    if(pageCache.entries.empty()) {
+        return false;
+    }
+    auto it = pageCache.entries.lower_bound(pageCache.clockHand);
+    for(size_t scanned = 0; scanned < pageCache.entries.size(); scanned++, ++it) {
+        if(it == pageCache.entries.end()) {
+            it = pageCache.entries.begin();
+        }
+        CacheEntry &entry = it->second;
+        if(entry.referenced == 1) {
+            entry.referenced = 0;
+            continue;
+        }
+        bool pinned = false;
+        for(auto const& mapper : entry.mappers) {
+            pinned = pinned || processTable.table[mapper.first]->pageTable[mapper.second].pinned > 0;
+        }
+        if(pinned) {
+            continue;
+        }
+        for(auto const& mapper : entry.mappers) {
+            Process *process = processTable.table[mapper.first];
+            PageUnit &page = process->pageTable[mapper.second];
+            page.frameNumber = -1;
+            syncCurrentPage(process, page);
+        }
+        int fileId = it->first.first;
+        releaseFrame(entry.frame);
+        pageCache.clockHand = it->first;
+        pageCache.entries.erase(it);
+        pageCache.files[fileId].cachedPages--;
+        pageCache.drops++;
+        pageCacheForget(fileId);
+        return true;
+    }
+    return false;
+}
+
+//closes a file once it is neither mapped nor cached
+void pageCacheForget(int fileId) {
+    auto fileIt = pageCache.files.find(fileId);
+    if(fileIt == pageCache.files.end() || fileIt->second.mappings > 0 || fileIt->second.cachedPages > 0) {
+        return;
+    }
+    MappedFile &file = fileIt->second;
+    if(file.fd != -1) {
+        close(file.fd);
+        auto idIt = pageCache.fileIds.find(make_pair(file.device, file.inode));
+        if(idIt != pageCache.fileIds.end() && idIt->second == fileId) {
+            pageCache.fileIds.erase(idIt);
+        }
+    }
+    pageCache.files.erase(fileIt);
+}
+
+//forgets every mapped file and cached page, used by load which replaces all frames
+void pageCacheReset() {
+    for(auto const& loc : pageCache.files) {
+        if(loc.second.fd != -1) {
+            close(loc.second.fd);
+        }
+    }
+    pageCache.files.clear();
+    pageCache.fileIds.clear();
+    pageCache.mappings.clear();
+    pageCache.entries.clear();
+    pageCache.clockHand = make_pair(INT_MIN, LLONG_MIN);
+    pageCache.nextFileId = 0;
+    pageCache.nextMapping = 0;
+}
+
+void printPageCache() {
+    printf("| %4s | %8s | %12s | %s \n", "File", "Mappings", "Cached Pages", "Path");
+    printf("+------+----------+--------------+------------------------\n");
+    for(auto const& loc : pageCache.files) {
+        printf("| %4d | %8d | %12d | %s \n", loc.first, loc.second.mappings, loc.second.cachedPages, loc.second.path.c_str());
+    }
+    printf("Cached pages: %zu, hits: %lld, misses: %lld, pages dropped: %lld, private copies: %lld\n",
+           pageCache.entries.size(), pageCache.hits, pageCache.misses, pageCache.drops, pageCache.copies);
+}
+
+//applies one name=value option of the generate command, false with a message if it is invalid
+bool setWorkloadOption(WorkloadConfig &config, string name, string value) {
+    if(name == "arrival_dist" || name == "lifetime_dist") {
+        int dist = workloadDistributionCode(value);
+        if(dist != WORKLOAD_EXPONENTIAL && dist != WORKLOAD_UNIFORM && dist != WORKLOAD_FIXED) {
+            cout << name << " must be exponential, uniform or fixed" << endl;
+            return false;
+        }
+        (name == "arrival_dist" ? config.arrivalDist : config.lifetimeDist) = dist;
+    } else if(name == "size_dist") {
+        int dist = workloadDistributionCode(value);
+        if(dist != WORKLOAD_UNIFORM && dist != WORKLOAD_ZIPF && dist != WORKLOAD_LOGNORMAL) {
+            cout << "size_dist must be uniform, zipf or lognormal" << endl;
+            return false;
+        }
+        config.sizeDist = dist;
+    } else if(name == "free_order") {
+        if(value == "fifo") {
+            config.freeOrder = WORKLOAD_FREE_FIFO;
+        } else if(value == "lifo") {
+            config.freeOrder = WORKLOAD_FREE_LIFO;
+        } else if(value == "random") {
+            config.freeOrder = WORKLOAD_FREE_RANDOM;
+        } else {
+            cout << "free_order must be fifo, lifo or random" << endl;
+            return false;
+        }
+    } else if(name == "types" || name == "ops") {
+        vector<int> weights;
+        int total = 0;
+        stringstream items(value);
+        string item;
+        while(getline(items, item, ',')) {
+            if(!isNumber(item) || item.size() > 6) {
+                weights.clear();
+                break;
+            }
+            weights.push_back(stoi(item));
+            total += weights.back();
+        }
+        size_t expected = name == "types" ? 6 : 4;
+        if(weights.size() != expected || total == 0) {
+            cout << name << " must be " << expected << " comma separated weights that are not all 0" << endl;
+            return false;
+        }
+        (name == "types" ? config.typeWeights : config.opWeights) = weights;
+    } else if(name == "arrival" || name == "lifetime" || name == "zipf_s" || name == "size_mu" || name == "size_sigma") {
+        double number;
+        try {
+            number = stod(value);
+        } catch (const exception& e) {
+            cout << "The value of " << name << " must be a number" << endl;
+            return false;
+        }
+        if(!(number >= 0 && number < 1e15) || (number == 0 && name != "size_mu" && name != "size_sigma")) {
+            cout << "The value of " << name << " must be " << (name == "size_mu" || name == "size_sigma" ? "at least 0" : "greater than 0") << endl;
+            return false;
+        }
+        if(name == "arrival") {
+            config.arrivalMean = number;
+        } else if(name == "lifetime") {
+            config.lifetimeMean = number;
+        } else if(name == "zipf_s") {
+            config.zipfExponent = number;
+        } else if(name == "size_mu") {
+            config.sizeMu = number;
+        } else {
+            config.sizeSigma = number;
+        }
+    } else if(name == "processes" || name == "address_bits" || name == "size_min" || name == "size_max"
+              || name == "verify" || name == "keep") {
+        if(!isNumber(value) || value.size() > 9) {
+            cout << "The value of " << name << " must be a non negative integer" << endl;
+            return false;
+        }
+        int number = stoi(value);
+        if(name == "processes" && (number < 1 || number > 4096)) {
+            cout << "processes must be from 1 to 4096" << endl;
+            return false;
+        } else if(name == "address_bits" && (number < 17 || number > maxAddressBits())) {
+            cout << "address_bits must be from 17 to " << maxAddressBits() << " with this page size" << endl;
+            return false;
+        } else if((name == "size_min" || name == "size_max") && (number < 1 || number > 16777216)) {
+            cout << name << " must be from 1 to 16777216 elements" << endl;
+            return false;
+        } else if((name == "verify" || name == "keep") && number > 1) {
+            cout << name << " must be 0 or 1" << endl;
+            return false;
+        }
+        if(name == "processes") {
+            config.processes = number;
+        } else if(name == "address_bits") {
+            config.addressBits = number;
+        } else if(name == "size_min") {
+            config.sizeMin = number;
+        } else if(name == "size_max") {
+            config.sizeMax = number;
+        } else if(name == "verify") {
+            config.verify = number == 1;
+        } else {
+            config.keep = number == 1;
+        }
+    } else {
+        cout << name << " is not a workload option" << endl;
+        return false;
+    }
+    return true;
+}
+
+int workloadDistributionCode(string name) {
+    if(name == "exponential") {
+        return WORKLOAD_EXPONENTIAL;
+    } else if(name == "uniform") {
+        return WORKLOAD_UNIFORM;
+    } else if(name == "fixed") {
+        return WORKLOAD_FIXED;
+    } else if(name == "zipf") {
+        return WORKLOAD_ZIPF;
+    } else if(name == "lognormal") {
+        return WORKLOAD_LOGNORMAL;
+    }
+    return -1;
+}
+
+//operations until the next arrival or until a process ends, at least 1
+long long workloadInterval(mt19937_64 &rng, int dist, double mean) {
+    double interval = mean;
+    if(dist == WORKLOAD_EXPONENTIAL) {
+        interval = exponential_distribution<double>(1.0 / mean)(rng);
+    } else if(dist == WORKLOAD_UNIFORM) {
+        interval = uniform_real_distribution<double>(0, 2 * mean)(rng);
+    }
+    return max(1LL, (long long)interval);
+}
+
+//elements of the next allocation. zipfCdf holds the cumulative probabilities of the
+//sizes sizeMin, sizeMin + 1, ... sizeMax, the smallest being the most likely
+int workloadSize(const WorkloadConfig &config, mt19937_64 &rng, const vector<double> &zipfCdf) {
+    if(config.sizeDist == WORKLOAD_ZIPF) {
+        double pick = uniform_real_distribution<double>(0, zipfCdf.back())(rng);
+        return config.sizeMin + (int)(lower_bound(zipfCdf.begin(), zipfCdf.end(), pick) - zipfCdf.begin());
+    }
+    if(config.sizeDist == WORKLOAD_LOGNORMAL) {
+        double size = lognormal_distribution<double>(config.sizeMu, config.sizeSigma)(rng);
+        return (int)min((double)config.sizeMax, max((double)config.sizeMin, size + 0.5));
+    }
+    return uniform_int_distribution<int>(config.sizeMin, config.sizeMax)(rng);
+}
+
+//Runs config.operations random operations against the simulator functions the commands
+//use, without going through the command parser, and prints a summary. The same seed and
+//options give the same workload. Processes arrive while fewer than config.processes run
+//and are terminated when their lifetime is over.
+void runWorkload(const WorkloadConfig &config) {
+    if(config.sizeMin > config.sizeMax) {
+        cout << "size_min must not exceed size_max" << endl;
+        return;
+    }
+    static const char *typeNames[] = {"char", "short", "int", "double", "long", "float"};
+    mt19937_64 rng(config.seed);
+    srand(config.seed); //createProcess picks text and global sizes with rand
+    vector<double> zipfCdf;
+    if(config.sizeDist == WORKLOAD_ZIPF) {
+        double total = 0;
+        for(int rank = 1; rank <= config.sizeMax - config.sizeMin + 1; rank++) {
+            total += 1.0 / pow((double)rank, config.zipfExponent);
+            zipfCdf.push_back(total);
+        }
+    }
+    discrete_distribution<int> typePick(config.typeWeights.begin(), config.typeWeights.end());
+    discrete_distribution<int> opPick(config.opWeights.begin(), config.opWeights.end());
+
+    long long opCounts[4] = {0, 0, 0, 0}; //allocate free set read
+    long long failedAllocations = 0, failedCreates = 0, created = 0, finished = 0, lost = 0;
+    long long bytesWritten = 0, bytesRead = 0, mismatches = 0, nameCounter = 0;
+    long long killsBefore = oomInfo.kills, reclaimsBefore = reclaimInfo.directReclaims;
+    long long reclaimedBefore = reclaimInfo.pagesReclaimed;
+    long long storedBefore = zswapPool.stored;
+    long long pagesOutBefore, pagesInBefore;
+    {
+        lock_guard<mutex> guard(swapInfo.lock);
+        pagesOutBefore = swapInfo.pagesOut;
+        pagesInBefore = swapInfo.pagesIn;
+    }
+    vector<WorkloadProcess> live;
+    vector<uint8_t> buffer;
+    long long nextArrival = 0;
+    DiscardBuffer discard;
+    CoutRedirect silence(&discard); //the summary is printed with printf
+    auto started = chrono::steady_clock::now();
+
+    for(long long op = 0; op < config.operations; op++) {
+        //the reclaimer thread cannot get mainInfo.lock while a workload runs, so its pass
+        //runs here, between two operations
+        if(freeFrameCount() < reclaimInfo.lowWatermark) {
+            reclaimInfo.workloadPasses++;
+            reclaimPass(NULL);
+        }
+        //processes past their lifetime end, the ones the OOM killer took are forgotten
+        for(size_t i = 0; i < live.size(); ) {
+            if(processTable.table.count(live[i].pid) == 0) {
+                lost++;
+                live.erase(live.begin() + i);
+            } else if(live[i].death <= op) {
+                terminatePID(live[i].pid);
+                finished++;
+                live.erase(live.begin() + i);
+            } else {
+                i++;
+            }
+        }
+        if((op >= nextArrival && (int)live.size() < config.processes) || live.empty()) {
+            if(op >= nextArrival) {
+                nextArrival = op + workloadInterval(rng, config.arrivalDist, config.arrivalMean);
+            }
+            int pid = mainInfo.currentPID;
+            createProcess(config.addressBits, numaInfo.nextNode, numaInfo.policy);
+            numaInfo.nextNode = (numaInfo.nextNode + 1) % numaInfo.nodes.size();
+            if(processTable.table.count(pid) == 1) {
+                WorkloadProcess process;
+                process.pid = pid;
+                process.death = op + workloadInterval(rng, config.lifetimeDist, config.lifetimeMean);
+                live.push_back(std::move(process));
+                created++;
+            } else {
+                failedCreates++;
+            }
+            if(live.empty()) {
+                continue;
+            }
+        }
+
+        WorkloadProcess &process = live[uniform_int_distribution<size_t>(0, live.size() - 1)(rng)];
+        int kind = opPick(rng);
+        if(process.variables.empty()) {
+            kind = 0; //nothing to free, set or read yet
+        }
+        opCounts[kind]++;
+        if(kind == 0) {
+            int typeCode = typePick(rng) + 1;
+            int count = workloadSize(config, rng, zipfCdf);
+            string name = "w" + to_string(nameCounter++);
+            allocateVariable(process.pid, name, typeNames[typeCode - 1], count);
+            if(processTable.table.count(process.pid) == 0 || mmuTable.table.count(to_string(process.pid) + name) == 0) {
+                failedAllocations++;
+                continue;
+            }
+            WorkloadVariable variable;
+            variable.name = name;
+            variable.typeCode = typeCode;
+            variable.count = count;
+            if(config.verify) {
+                variable.shadow.resize((size_t)count * typeCodeSize(typeCode));
+                variable.known.resize(variable.shadow.size());
+            }
+            process.variables.push_back(std::move(variable));
+        } else if(kind == 1) {
+            size_t index = 0;
+            if(config.freeOrder == WORKLOAD_FREE_LIFO) {
+                index = process.variables.size() - 1;
+            } else if(config.freeOrder == WORKLOAD_FREE_RANDOM) {
+                index = uniform_int_distribution<size_t>(0, process.variables.size() - 1)(rng);
+            }
+            freeVariable(process.pid, process.variables[index].name);
+            if(index == 0) {
+                process.variables.pop_front();
+            } else {
+                //random order does not need the allocation order, the last one takes the slot
+                swap(process.variables[index], process.variables.back());
+                process.variables.pop_back();
+            }
+            compactIfFragmented(process.pid);
+        } else {
+            //set or read a run of up to 64 elements at a random place
+            WorkloadVariable &variable = process.variables[uniform_int_distribution<size_t>(0, process.variables.size() - 1)(rng)];
+            int elementSize = typeCodeSize(variable.typeCode);
+            int first = uniform_int_distribution<int>(0, variable.count - 1)(rng);
+            int elements = uniform_int_distribution<int>(1, min(64, variable.count - first))(rng);
+            int offset = first * elementSize;
+            int length = elements * elementSize;
+            buffer.resize(length);
+            MMUObject &mmu = mmuTable.table.at(to_string(process.pid) + variable.name);
+            if(kind == 2) {
+                for(int i = 0; i < length; i++) {
+                    buffer[i] = (uint8_t)rng();
+                }
+                mmu.set = true;
+                copyToVariable(mmu, offset, buffer.data(), length);
+                bytesWritten += length;
+                if(config.verify) {
+                    for(int i = 0; i < length; i++) {
+                        variable.shadow[offset + i] = buffer[i];
+                        variable.known[offset + i] = true;
+                    }
+                }
+            } else {
+                copyFromVariable(mmu, offset, buffer.data(), length);
+                bytesRead += length;
+                if(config.verify) {
+                    for(int i = 0; i < length; i++) {
+                        if(variable.known[offset + i] && variable.shadow[offset + i] != buffer[i]) {
+                            mismatches++;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    for(const WorkloadProcess &process : live) {
+        if(processTable.table.count(process.pid) == 0) {
+            lost++;
+        } else if(!config.keep) {
+            terminatePID(process.pid);
+        }
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+    long long pagesOut, pagesIn;
+    {
+        lock_guard<mutex> guard(swapInfo.lock);
+        pagesOut = swapInfo.pagesOut - pagesOutBefore;
+        pagesIn = swapInfo.pagesIn - pagesInBefore;
+    }
+    printf("|%24s | %14s \n", "Workload", "Value");
+    printf("+-------------------------+----------------\n");
+    printf("| %23s | %14llu \n", "seed", config.seed);
+    printf("| %23s | %14lld \n", "operations", config.operations);
+    printf("| %23s | %14lld \n", "allocations", opCounts[0]);
+    printf("| %23s | %14lld \n", "failed allocations", failedAllocations);
+    printf("| %23s | %14lld \n", "frees", opCounts[1]);
+    printf("| %23s | %14lld \n", "sets", opCounts[2]);
+    printf("| %23s | %14lld \n", "reads", opCounts[3]);
+    printf("| %23s | %14lld \n", "bytes written", bytesWritten);
+    printf("| %23s | %14lld \n", "bytes read", bytesRead);
+    printf("| %23s | %14lld \n", "processes created", created);
+    printf("| %23s | %14lld \n", "failed creates", failedCreates);
+    printf("| %23s | %14lld \n", "processes finished", finished);
+    printf("| %23s | %14lld \n", "processes lost to OOM", lost);
+    printf("| %23s | %14lld \n", "OOM kills", oomInfo.kills - killsBefore);
+    printf("| %23s | %14lld \n", "direct reclaims", reclaimInfo.directReclaims - reclaimsBefore);
+    printf("| %23s | %14lld \n", "reclaimed between ops", reclaimInfo.pagesReclaimed - reclaimedBefore);
+    //evictions land in zswap first, memfile.txt only sees what zswap rejects or writes back
+    printf("| %23s | %14lld \n", "pages stored in zswap", zswapPool.stored - storedBefore);
+    printf("| %23s | %14lld \n", "pages written to disk", pagesOut);
+    printf("| %23s | %14lld \n", "pages swapped in", pagesIn);
+    if(config.verify) {
+        printf("| %23s | %14lld \n", "reads that mismatched", mismatches);
+    }
+    printf("| %23s | %14.3f \n", "seconds", seconds);
+    printf("| %23s | %14.0f \n", "operations per second", seconds > 0 ? config.operations / seconds : 0.0);
+}
+
+//hints from the process about how it will use a variable, applied to its pages
+void adviseVariable(int pid, string name, string advice) {
+    Process *process = processTable.table[pid];
+    MMUObject &mmu = mmuTable.table.at(to_string(pid)+name);
+    int pageSize = commandInput.pageSize;
+    if(advice == "populate") {
+        //fault every page in now and keep it in RAM until free, dontneed or normal
+        if(!mmu.pinned) {
+            int newlyPinned = 0;
+            for(auto const& loc : mmu.pageInfo) {
+                if(process->pageTable[loc.first].pinned == 0) {
+                    newlyPinned++;
+                }
+            }
+            if(pinnedPageCount() + newlyPinned > 67108864 / pageSize * PIN_LIMIT_PERCENT / 100) {
+                cout << "Pinning " << name << " would pin more than " << PIN_LIMIT_PERCENT << "% of RAM" << endl;
+                return;
+            }
+            pinPages(process, mmu, 1);
+            mmu.pinned = true;
+        }
+        if(!populateVariable(process, mmu)) {
+            pinPages(process, mmu, -1);
+            mmu.pinned = false;
+            cout << "Out of memory while populating " << name << endl;
+            return;
+        }
+        cout << "Populated and pinned " << mmu.pageInfo.size() << " pages of " << name << endl;
+    } else if(advice == "willneed") {
+        //the I/O thread reads the swap slots ahead in one batch, compressed pages are in
+        //RAM already and mapped pages are read into the page cache right away
+        vector<int> slots;
+        int fileReads = 0;
+        for(auto const& loc : mmu.pageInfo) {
+            PageUnit &page = process->pageTable[loc.first];
+            if(page.inMem == 1) {
+                auto slotIt = swapSpace.swapMap.find(make_pair(pid, loc.first));
+                if(slotIt != swapSpace.swapMap.end() && slots.size() < SWAP_PREFETCH_LIMIT) {
+                    slots.push_back(slotIt->second);
+                }
+            } else if(page.mapping != -1 && page.frameNumber == -1) {
+                filePageIn(process, page);
+                if(page.frameNumber != -1) {
+                    fileReads++;
+                }
+            }
+        }
+        if(!slots.empty()) {
+            lock_guard<mutex> guard(swapInfo.lock);
+            swapInfo.prefetchQueue.insert(swapInfo.prefetchQueue.end(), slots.begin(), slots.end());
+            swapInfo.wake.notify_one();
+        }
+        cout << "Reading " << slots.size() << " swapped pages of " << name << " ahead";
+        if(fileReads > 0) {
+            cout << ", read " << fileReads << " pages from its file";
+        }
+        cout << endl;
+    } else if(advice == "dontneed") {
+        //pages holding nothing else lose their frame or swap slot and come back zeroed (or
+        //from the file for a mapping) on the next access, on shared pages only the bytes
+        //of the variable are cleared
+        if(mmu.pinned) {
+            pinPages(process, mmu, -1);
+            mmu.pinned = false;
+        }
+        vector<uint8_t> zeros(pageSize, 0);
+        int dropped = 0;
+        int offset = 0;
+        for(auto const& loc : mmu.pageInfo) {
+            PageUnit &page = process->pageTable[loc.first];
+            int freeSpace = loc.first == process->currentPage.pageNumber ? process->currentPage.freeSpace : page.freeSpace;
+            if(mmu.mapping != -1 || freeSpace + loc.second == pageSize) {
+                if(page.mapping != -1) {
+                    pageCacheDetach(process, page);
+                } else if(page.inMem == 1) {
+                    releaseSwappedPage(pid, loc.first);
+                    process->swappedPages--;
+                } else if(page.frameNumber != -1) {
+                    frameTable.table.erase(page.frameNumber);
+                    releaseFrame(page.frameNumber);
+                    process->residentPages--;
+                }
+                page.frameNumber = -1;
+                page.inMem = 0;
+                page.referenced = 0;
+                page.dirty = 0;
+                page.mapping = mmu.mapping;
+                syncCurrentPage(process, page);
+                dropped++;
+            } else {
+                copyToVariable(mmu, offset, zeros.data(), loc.second);
+            }
+            offset += loc.second;
+        }
+        cout << "Dropped " << dropped << " of the " << mmu.pageInfo.size() << " pages of " << name << endl;
+    } else if(advice == "cold") {
+        //take away the second chance the clock would give the pages, anonymous pages are
+        //also queued to be evicted before anything else
+        int marked = 0;
+        for(auto const& loc : mmu.pageInfo) {
+            PageUnit &page = process->pageTable[loc.first];
+            page.referenced = 0;
+            syncCurrentPage(process, page);
+            if(page.pinned > 0 || page.frameNumber == -1 || page.inMem == 1) {
+                continue;
+            }
+            if(page.mapping != -1) {
+                auto entryIt = pageCache.entries.find(pageCacheKey(page));
+                if(entryIt != pageCache.entries.end()) {
+                    entryIt->second.referenced = 0;
+                }
+            } else {
+                adviseInfo.coldPages.insert(make_pair(pid, loc.first));
+            }
+            marked++;
+        }
+        cout << "Marked " << marked << " pages of " << name << " as the next eviction victims" << endl;
+    } else {
+        if(mmu.pinned) {
+            pinPages(process, mmu, -1);
+            mmu.pinned = false;
+        }
+        for(auto const& loc : mmu.pageInfo) {
+            adviseInfo.coldPages.erase(make_pair(pid, loc.first));
+        }
+        cout << "Cleared the advice given for " << name << endl;
+    }
+}
+
+//adds delta to the pin count of every page of mmu
+void pinPages(Process *process, const MMUObject& mmu, int delta) {
+    for(auto const& loc : mmu.pageInfo) {
+        PageUnit &page = process->pageTable[loc.first];
+        page.pinned += delta;
+        syncCurrentPage(process, page);
+    }
+}
+
+//faults every page of mmu into RAM, false if memory ran out
+bool populateVariable(Process *process, MMUObject& mmu) {
+    for(auto const& loc : mmu.pageInfo) {
+        if(pageFrameAddress(process, loc.first) == NULL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int pinnedPageCount() {
+    int count = 0;
+    for(auto const& processLoc : processTable.table) {
+        for(PageUnit *page : processLoc.second->pageTable.entries()) {
+            if(page->pinned > 0) {
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+void forgetColdPages(int pid) {
+    auto coldIt = adviseInfo.coldPages.lower_bound(make_pair(pid, INT_MIN));
+    while(coldIt != adviseInfo.coldPages.end() && coldIt->first == pid) {
+        coldIt = adviseInfo.coldPages.erase(coldIt);
+    }
+}